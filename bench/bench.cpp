@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "matrix.h"
+#include "lu.h"
+#include "refined_solve.h"
+
+/* benchmark of the Matrix operations over a sweep of sizes and thread counts, built with `make bench`.
+  Every case is repeated until it ran for a minimum time (and at least a minimum number of times); the
+  median and 99th percentile of the repeats are reported, with GFLOP/s and GB/s worked out from the
+  median and the nominal flop and byte counts of the operation (see operations()). Matrices are
+  square, filled with random values and made diagonally dominant so every one of them is invertible.
+
+	usage: benchmark [--sizes 32,128,512] [--threads 1,4] [--ops multiply,add,...] [--min-time 0.2]
+	                 [--min-repeats 5] [--strassen-crossover 256] [--json file|-]
+
+  --json writes the results as JSON to a file, or to standard output instead of the table for "-".
+  The strassen case runs with the crossover set to --strassen-crossover (put back afterwards), and only
+  on sizes above it: at or below it the product is the classical one under another name. */
+
+namespace {
+	using m::Matrix;
+	using clock_type = std::chrono::steady_clock;
+
+	struct Operation {
+		const char* name;
+		double flops;			// multiplied by n^3 (or n^2 when cubic is false)
+		bool cubic;
+		double bytes;			// multiplied by n^2 * sizeof(value_type): cells read and written once
+		bool mutating;			// needs a fresh copy of its operand before every repeat (not timed)
+		std::function<void(const Matrix&, const Matrix&, Matrix&)> run;
+	};
+
+	struct Result {
+		std::string op;
+		unsigned size, threads;
+		std::size_t repeats;
+		double median, p99;		// seconds
+		double gflops, gbs;
+	};
+
+	struct Options {
+		std::vector<unsigned> sizes {32, 128, 512, 1024};
+		std::vector<unsigned> threads {};
+		std::vector<std::string> ops {};
+		double min_time {0.2};
+		std::size_t min_repeats {5};
+		unsigned strassen_crossover {256};
+		std::string json {};
+	};
+
+	volatile Matrix::value_type sink;		// results are read into it, so no operation is optimized away
+
+	const std::vector<Operation>& operations () {
+		static const std::vector<Operation> list {
+			{"multiply", 2, true, 3, false, [] (const Matrix& t_a, const Matrix& t_b, Matrix&) {
+				Matrix c = t_a * t_b;
+				sink = c.getCell(0, 0);
+			}},
+			{"strassen", 2, true, 3, false, [] (const Matrix& t_a, const Matrix& t_b, Matrix&) {
+				Matrix c = m::product(t_a, t_b, Matrix::product_type::strassen);
+				sink = c.getCell(0, 0);
+			}},
+			{"add", 1, false, 3, false, [] (const Matrix& t_a, const Matrix& t_b, Matrix&) {
+				Matrix c = t_a + t_b;
+				sink = c.getCell(0, 0);
+			}},
+			{"transpose", 0, false, 2, false, [] (const Matrix&, const Matrix&, Matrix& t_work) {
+				sink = t_work.transpose().getCell(0, 0);
+			}},
+			{"echelon", 2.0 / 3, true, 2, true, [] (const Matrix&, const Matrix&, Matrix& t_work) {
+				sink = t_work.echelon().getCell(0, 0);
+			}},
+			{"reduced_echelon", 1, true, 2, true, [] (const Matrix&, const Matrix&, Matrix& t_work) {
+				sink = t_work.reduced_echelon().getCell(0, 0);
+			}},
+			{"invert", 2, true, 2, true, [] (const Matrix&, const Matrix&, Matrix& t_work) {
+				sink = t_work.invert().getCell(0, 0);
+			}},
+			{"solve", 8.0 / 3, true, 3, false, [] (const Matrix& t_a, const Matrix& t_b, Matrix&) {
+				Matrix x = m::solve(t_a, t_b);
+				sink = x.getCell(0, 0);
+			}},
+			{"refined_solve", 2.0 / 3, true, 1, false, [] (const Matrix& t_a, const Matrix&, Matrix&) {
+				m::RefinedSolution x = m::refinedSolve(t_a, std::vector<double>(t_a.getRows(), 1.0));
+				sink = Matrix::value_type(x.x[0]);
+			}},
+			{"determinant", 2.0 / 3, true, 1, true, [] (const Matrix&, const Matrix&, Matrix& t_work) {
+				sink = t_work.getDeterminant();
+			}},
+		};
+		return list;
+	}
+
+	Matrix randomMatrix (unsigned t_size, std::mt19937& t_random) {
+		std::uniform_real_distribution<Matrix::value_type> cell(-1, 1);
+		Matrix res(t_size, t_size);
+		Matrix::value_type* data = res.data();
+		for (unsigned i = 0; i < t_size; i++) {
+			for (unsigned j = 0; j < t_size; j++)
+				data[std::size_t(i) * res.stride() + j] = cell(t_random);
+			data[std::size_t(i) * res.stride() + i] += Matrix::value_type(t_size);
+		}
+		return res;
+	}
+
+	// nearest rank percentile of sorted t_samples
+	double percentile (const std::vector<double>& t_samples, double t_fraction) {
+		std::size_t rank = std::size_t(t_fraction * double(t_samples.size()) + 0.999999);
+		return t_samples[std::min(t_samples.size(), std::max<std::size_t>(rank, 1)) - 1];
+	}
+
+	Result measure (const Operation& t_op, unsigned t_size, unsigned t_threads, const Options& t_options) {
+		std::mt19937 random(t_size);
+		Matrix a = randomMatrix(t_size, random), b = randomMatrix(t_size, random);
+		Matrix work(a);
+		std::vector<double> samples;
+		double total = 0;
+		t_op.run(a, b, work);	// warm up: pool threads, caches and scratch buffers
+		while (samples.size() < t_options.min_repeats || total < t_options.min_time) {
+			if (t_op.mutating) {
+				work = a;
+				work.data();	// copies the cells a shares with it now, not in the timed run
+			}
+			clock_type::time_point start = clock_type::now();
+			t_op.run(a, b, work);
+			double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+			samples.push_back(elapsed);
+			total += elapsed;
+			if (samples.size() >= 100000) break;
+		}
+		std::sort(samples.begin(), samples.end());
+
+		Result res {t_op.name, t_size, t_threads, samples.size(), percentile(samples, 0.5), percentile(samples, 0.99), 0, 0};
+		double n = t_size;
+		double flops = t_op.flops * (t_op.cubic ? n * n * n : n * n);
+		double bytes = t_op.bytes * n * n * sizeof(Matrix::value_type);
+		res.gflops = flops / res.median * 1e-9;
+		res.gbs = bytes / res.median * 1e-9;
+		return res;
+	}
+
+	std::vector<unsigned> parseList (const char* t_text) {
+		std::vector<unsigned> res;
+		std::stringstream stream(t_text);
+		std::string item;
+		while (std::getline(stream, item, ',')) {
+			char* end = nullptr;
+			unsigned long value = std::strtoul(item.c_str(), &end, 10);
+			if (item.empty() || *end != '\0' || value == 0 || value > 65536) throw ("Not a positive number in list!");
+			res.push_back(unsigned(value));
+		}
+		if (res.empty()) throw ("Empty list!");
+		return res;
+	}
+
+	Options parseOptions (int t_argc, char** t_argv) {
+		Options res;
+		for (int k = 1; k < t_argc; k++) {
+			std::string flag = t_argv[k];
+			if (flag == "--help" || flag == "-h") throw ("");
+			if (k + 1 == t_argc) throw ("Missing value after option!");
+			const char* value = t_argv[++k];
+			if (flag == "--sizes") res.sizes = parseList(value);
+			else if (flag == "--threads") res.threads = parseList(value);
+			else if (flag == "--min-time") res.min_time = std::atof(value);
+			else if (flag == "--min-repeats") res.min_repeats = std::max<std::size_t>(1, std::strtoul(value, nullptr, 10));
+			else if (flag == "--strassen-crossover") {
+				res.strassen_crossover = parseList(value).front();
+				if (res.strassen_crossover < 32) throw ("Strassen crossover must be at least 32!");
+			}
+			else if (flag == "--json") res.json = value;
+			else if (flag == "--ops") {
+				std::stringstream stream(value);
+				std::string name;
+				while (std::getline(stream, name, ',')) {
+					bool known = std::any_of(operations().begin(), operations().end(),
+							[&] (const Operation& t_op) { return name == t_op.name; });
+					if (!known) throw ("Unknown operation!");
+					res.ops.push_back(name);
+				}
+			}
+			else throw ("Unknown option!");
+		}
+		if (res.threads.empty()) {
+			unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+			res.threads.push_back(1);
+			if (hardware > 1) res.threads.push_back(hardware);
+		}
+		return res;
+	}
+
+	void printTable (const std::vector<Result>& t_results, std::ostream& t_stream) {
+		char line[160];
+		std::snprintf(line, sizeof(line), "%-16s %6s %7s %8s %12s %12s %10s %10s\n",
+				"operation", "size", "threads", "repeats", "median (ms)", "p99 (ms)", "GFLOP/s", "GB/s");
+		t_stream << line;
+		for (const Result& result : t_results) {
+			std::snprintf(line, sizeof(line), "%-16s %6u %7u %8zu %12.4f %12.4f %10.2f %10.2f\n",
+					result.op.c_str(), result.size, result.threads, result.repeats,
+					result.median * 1e3, result.p99 * 1e3, result.gflops, result.gbs);
+			t_stream << line;
+		}
+		t_stream.flush();
+	}
+
+	void printJson (const std::vector<Result>& t_results, std::ostream& t_stream) {
+		char line[320];
+		t_stream << "{\n  \"benchmark\": \"matrix\",\n  \"results\": [\n";
+		for (std::size_t k = 0; k < t_results.size(); k++) {
+			const Result& result = t_results[k];
+			std::snprintf(line, sizeof(line), "    {\"op\": \"%s\", \"size\": %u, \"threads\": %u, \"repeats\": %zu, "
+					"\"median_ms\": %.6f, \"p99_ms\": %.6f, \"gflops\": %.4f, \"gbs\": %.4f}%s\n",
+					result.op.c_str(), result.size, result.threads, result.repeats, result.median * 1e3,
+					result.p99 * 1e3, result.gflops, result.gbs, k + 1 < t_results.size() ? "," : "");
+			t_stream << line;
+		}
+		t_stream << "  ]\n}\n";
+		t_stream.flush();
+	}
+}
+
+int main (int argc, char** argv) {
+	Options options;
+	try {
+		options = parseOptions(argc, argv);
+	}
+	catch (const char* error) {
+		if (*error) std::cerr << error << "\n";
+		std::cerr << "usage: " << argv[0] << " [--sizes 32,128,512] [--threads 1,4] [--ops multiply,add,...]"
+				" [--min-time seconds] [--min-repeats count] [--strassen-crossover size] [--json file|-]\noperations:";
+		for (const Operation& op : operations()) std::cerr << " " << op.name;
+		std::cerr << "\n";
+		return *error ? 1 : 0;
+	}
+
+	bool table = options.json != "-";
+	std::vector<Result> results;
+	for (const Operation& op : operations()) {
+		if (!options.ops.empty() && std::find(options.ops.begin(), options.ops.end(), op.name) == options.ops.end())
+			continue;
+		// below the default crossover (1024) the strassen case would time the classical product (see the usage)
+		bool strassen = std::strcmp(op.name, "strassen") == 0;
+		Matrix::length_type crossover = Matrix::getStrassenCrossover();
+		if (strassen) Matrix::setStrassenCrossover(options.strassen_crossover);
+		for (unsigned threads : options.threads) {
+			Matrix::setThreads(threads);
+			for (unsigned size : options.sizes) {
+				if (strassen && size <= options.strassen_crossover) continue;
+				results.push_back(measure(op, size, threads, options));
+				if (table) {	// rows come out as they are measured, the header only once
+					std::ostringstream row;
+					printTable({results.back()}, row);
+					std::string text = row.str();
+					std::cout << (results.size() == 1 ? text : text.substr(text.find('\n') + 1)) << std::flush;
+				}
+			}
+		}
+		Matrix::setStrassenCrossover(crossover);
+	}
+
+	if (options.json == "-") printJson(results, std::cout);
+	else if (!options.json.empty()) {
+		std::ofstream file(options.json);
+		printJson(results, file);
+		if (!file) {
+			std::cerr << "Couldn't write " << options.json << "\n";
+			return 1;
+		}
+	}
+	return 0;
+}
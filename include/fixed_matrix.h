@@ -0,0 +1,286 @@
+#ifndef MATRIX_FIXED_CRYPT_10_10
+#define MATRIX_FIXED_CRYPT_10_10
+
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include "matrix.h"
+
+namespace m {
+
+	/* matrix of T (floating point or integer) whose dimensions are part of its type. Cells live inside
+	  the object (on the stack, no allocation), every loop bound is known to the compiler, and everything
+	  is constexpr: small products, transposes, determinants and inverses can be computed at compile time,
+	  and at run time a 4x4 product unrolls into a few vector multiply-adds (fused when the target has FMA
+	  and -ffp-contract allows it). */
+	template <class T, std::size_t R, std::size_t C>
+	class FixedMatrix {
+			static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, "Cells of a matrix must be numbers!");
+			static_assert(R > 0 && C > 0, "Number of rows and columns must be positive!");
+
+		public:
+			using value_type		= T;
+			using length_type		= std::size_t;
+
+			// creates a zero matrix
+			constexpr FixedMatrix () : m_cells {} {}
+
+			// creates a matrix from its cells given row by row (throws if their count isn't R * C)
+			constexpr FixedMatrix (std::initializer_list<T> t_cells) : m_cells {} {
+				if (t_cells.size() != R * C) throw ("Number of cells doesn't match dimensions!");
+				std::size_t k = 0;
+				for (T cell : t_cells) m_cells[k++] = cell;
+			}
+
+			// creates a copy of the cells of t_matrix converted to T (throws if dimensions don't match)
+			explicit FixedMatrix (const ConstMatrixView& t_matrix) : m_cells {} {
+				if (t_matrix.getRows() != R || t_matrix.getColumns() != C) throw ("Dimensions of matrices don't match!");
+				for (std::size_t i = 0; i < R; i++)
+					for (std::size_t j = 0; j < C; j++)
+						m_cells[i * C + j] = static_cast<T>(t_matrix.data()[i * t_matrix.stride() + j]);
+			}
+			explicit FixedMatrix (const Matrix& t_matrix) : FixedMatrix(t_matrix.view()) {}
+
+			// returns the identity matrix (square matrices only)
+			static constexpr FixedMatrix identity () {
+				static_assert(R == C, "Only square matrices have an identity!");
+				FixedMatrix res;
+				for (std::size_t i = 0; i < R; i++) res.m_cells[i * C + i] = T(1);
+				return res;
+			}
+
+			// returns the number of rows
+			static constexpr length_type getRows () { return R; }
+
+			// returns the number of columns
+			static constexpr length_type getColumns () { return C; }
+
+			// returns the cell at t_row and t_column, unchecked
+			constexpr T& operator() (length_type t_row, length_type t_column) { return m_cells[t_row * C + t_column]; }
+			constexpr const T& operator() (length_type t_row, length_type t_column) const { return m_cells[t_row * C + t_column]; }
+
+			// returns value of cell at t_row and t_column indices (throws if out of bound)
+			constexpr T getCell (length_type t_row, length_type t_column) const {
+				if (t_row >= R || t_column >= C) throw ("Indices are out of bound!");
+				return m_cells[t_row * C + t_column];
+			}
+
+			// sets value of cell at t_row and t_column indices (throws if out of bound)
+			constexpr void setCell (length_type t_row, length_type t_column, T t_value) {
+				if (t_row >= R || t_column >= C) throw ("Indices are out of bound!");
+				m_cells[t_row * C + t_column] = t_value;
+			}
+
+			// returns the cells, row by row with no padding
+			constexpr T* data () { return m_cells; }
+			constexpr const T* data () const { return m_cells; }
+
+			// returns a float Matrix holding the same cells
+			Matrix toMatrix () const {
+				Matrix res(static_cast<Matrix::length_type>(R), static_cast<Matrix::length_type>(C));
+				Matrix::value_type* cells = detail::writableView(res).data();
+				for (std::size_t i = 0; i < R; i++)
+					for (std::size_t j = 0; j < C; j++)
+						cells[i * res.stride() + j] = static_cast<Matrix::value_type>(m_cells[i * C + j]);
+				return res;
+			}
+
+			constexpr FixedMatrix operator+ (const FixedMatrix& t_matrix) const {
+				FixedMatrix res(*this);
+				return res += t_matrix;
+			}
+
+			constexpr FixedMatrix operator- (const FixedMatrix& t_matrix) const {
+				FixedMatrix res(*this);
+				return res -= t_matrix;
+			}
+
+			constexpr FixedMatrix operator* (T t_constant) const {
+				FixedMatrix res(*this);
+				return res *= t_constant;
+			}
+
+			constexpr FixedMatrix& operator+= (const FixedMatrix& t_matrix) {
+				for (std::size_t k = 0; k < R * C; k++) m_cells[k] += t_matrix.m_cells[k];
+				return *this;
+			}
+
+			constexpr FixedMatrix& operator-= (const FixedMatrix& t_matrix) {
+				for (std::size_t k = 0; k < R * C; k++) m_cells[k] -= t_matrix.m_cells[k];
+				return *this;
+			}
+
+			constexpr FixedMatrix& operator*= (T t_constant) {
+				for (std::size_t k = 0; k < R * C; k++) m_cells[k] *= t_constant;
+				return *this;
+			}
+
+			// returns this * t_matrix; dimensions are checked at compile time
+			template <std::size_t K>
+			constexpr FixedMatrix<T, R, K> operator* (const FixedMatrix<T, C, K>& t_matrix) const {
+				FixedMatrix<T, R, K> res;
+				for (std::size_t i = 0; i < R; i++)
+					for (std::size_t j = 0; j < K; j++)
+						res.m_cells[i * K + j] = m_dot(t_matrix, i, j, std::make_index_sequence<C>());
+				return res;
+			}
+
+			// square matrices only: sets the matrix to this * t_matrix
+			constexpr FixedMatrix& operator*= (const FixedMatrix& t_matrix) {
+				return *this = *this * t_matrix;
+			}
+
+			constexpr bool operator== (const FixedMatrix& t_matrix) const {
+				for (std::size_t k = 0; k < R * C; k++)
+					if (!(m_cells[k] == t_matrix.m_cells[k])) return false;
+				return true;
+			}
+
+			constexpr bool operator!= (const FixedMatrix& t_matrix) const {
+				return !(*this == t_matrix);
+			}
+
+			// returns the transpose (a new matrix, as its type differs unless square)
+			constexpr FixedMatrix<T, C, R> transposed () const {
+				FixedMatrix<T, C, R> res;
+				for (std::size_t i = 0; i < R; i++)
+					for (std::size_t j = 0; j < C; j++)
+						res.m_cells[j * R + i] = m_cells[i * C + j];
+				return res;
+			}
+
+			/* returns the determinant (square matrices only): closed forms up to 3x3, then elimination with
+			  partial pivoting, or fraction-free (Bareiss) elimination for integers so the result stays exact */
+			constexpr T determinant () const {
+				static_assert(R == C, "Only square matrices have a determinant!");
+				static_assert(std::is_signed<T>::value, "Determinants need a signed cell type!");
+				const T* a = m_cells;
+				if constexpr (R == 1) return a[0];
+				else if constexpr (R == 2) return a[0] * a[3] - a[1] * a[2];
+				else if constexpr (R == 3)
+					return a[0] * (a[4] * a[8] - a[5] * a[7]) - a[1] * (a[3] * a[8] - a[5] * a[6])
+							+ a[2] * (a[3] * a[7] - a[4] * a[6]);
+				else if constexpr (std::is_integral<T>::value) return m_bareiss();
+				else return m_eliminate(nullptr);
+			}
+
+			// returns the inverse (square floating point matrices only, throws if the determinant is zero)
+			constexpr FixedMatrix inverse () const {
+				static_assert(R == C, "Only square matrices have an inverse!");
+				static_assert(std::is_floating_point<T>::value, "Only floating point matrices can be inverted!");
+				FixedMatrix res = identity();
+				if (m_eliminate(&res) == T(0)) throw ("Matrix with zero determinant!");
+				return res;
+			}
+
+		private:
+			template <class, std::size_t, std::size_t> friend class FixedMatrix;
+
+			T m_cells[R * C];
+
+			// dot product of row t_i with column t_j of t_matrix, spelled out term by term
+			template <std::size_t K, std::size_t... P>
+			constexpr T m_dot (const FixedMatrix<T, C, K>& t_matrix, std::size_t t_i, std::size_t t_j,
+					std::index_sequence<P...>) const {
+				return (... + (m_cells[t_i * C + P] * t_matrix.m_cells[P * K + t_j]));
+			}
+
+			static constexpr T m_abs (T t_value) { return t_value < T(0) ? -t_value : t_value; }
+
+			/* Gauss-Jordan elimination with partial pivoting on a copy, returning the determinant; the same
+			  row operations turn *t_inverse (if given, holding the identity) into the inverse */
+			constexpr T m_eliminate (FixedMatrix* t_inverse) const {
+				FixedMatrix a(*this);
+				T det = T(1);
+				for (std::size_t j = 0; j < R; j++) {
+					std::size_t pivot = j;
+					for (std::size_t i = j + 1; i < R; i++)
+						if (m_abs(a.m_cells[i * C + j]) > m_abs(a.m_cells[pivot * C + j])) pivot = i;
+					if (a.m_cells[pivot * C + j] == T(0)) return T(0);
+					if (pivot != j) {
+						a.m_swapRows(j, pivot);
+						if (t_inverse) t_inverse->m_swapRows(j, pivot);
+						det = -det;
+					}
+					T diagonal = a.m_cells[j * C + j];
+					det *= diagonal;
+					for (std::size_t i = t_inverse ? 0 : j + 1; i < R; i++) {
+						if (i == j) continue;
+						T multiple = a.m_cells[i * C + j] / diagonal;
+						for (std::size_t c = j; c < C; c++) a.m_cells[i * C + c] -= multiple * a.m_cells[j * C + c];
+						if (t_inverse)
+							for (std::size_t c = 0; c < C; c++) t_inverse->m_cells[i * C + c] -= multiple * t_inverse->m_cells[j * C + c];
+					}
+				}
+				if (t_inverse)
+					for (std::size_t i = 0; i < R; i++)
+						for (std::size_t c = 0; c < C; c++) t_inverse->m_cells[i * C + c] /= a.m_cells[i * C + i];
+				return det;
+			}
+
+			// fraction-free elimination: every division is exact, the last pivot is the determinant
+			constexpr T m_bareiss () const {
+				FixedMatrix a(*this);
+				T previous = T(1), sign = T(1);
+				for (std::size_t j = 0; j + 1 < R; j++) {
+					if (a.m_cells[j * C + j] == T(0)) {
+						std::size_t pivot = j + 1;
+						while (pivot < R && a.m_cells[pivot * C + j] == T(0)) pivot++;
+						if (pivot == R) return T(0);
+						a.m_swapRows(j, pivot);
+						sign = -sign;
+					}
+					for (std::size_t i = j + 1; i < R; i++)
+						for (std::size_t c = j + 1; c < C; c++)
+							a.m_cells[i * C + c] = (a.m_cells[i * C + c] * a.m_cells[j * C + j]
+									- a.m_cells[i * C + j] * a.m_cells[j * C + c]) / previous;
+					previous = a.m_cells[j * C + j];
+				}
+				return sign * a.m_cells[R * C - 1];
+			}
+
+			constexpr void m_swapRows (std::size_t t_first, std::size_t t_second) {
+				for (std::size_t c = 0; c < C; c++) {
+					T cell = m_cells[t_first * C + c];
+					m_cells[t_first * C + c] = m_cells[t_second * C + c];
+					m_cells[t_second * C + c] = cell;
+				}
+			}
+	};
+
+	template <class T, std::size_t R, std::size_t C>
+	constexpr FixedMatrix<T, R, C> operator* (T t_constant, const FixedMatrix<T, R, C>& t_matrix) {
+		return t_matrix * t_constant;
+	}
+
+	// marks a dimension only known at run time
+	constexpr std::size_t Dynamic = std::size_t(-1);
+
+	namespace detail {
+		template <class T, std::size_t R, std::size_t C>
+		struct matrix_type {
+			static_assert(R != Dynamic && C != Dynamic, "Matrices sized at run time hold float and both dimensions are dynamic!");
+			using type = FixedMatrix<T, R, C>;
+		};
+
+		template <>
+		struct matrix_type<Matrix::value_type, Dynamic, Dynamic> {
+			using type = Matrix;
+		};
+	}
+
+	/* picks the matrix class for cells of T and dimensions R x C: FixedMatrix<T, R, C> for sizes known at
+	  compile time, Matrix for MatrixOf<float, Dynamic, Dynamic> */
+	template <class T, std::size_t R = Dynamic, std::size_t C = R>
+	using MatrixOf = typename detail::matrix_type<T, R, C>::type;
+
+	using Matrix2f = FixedMatrix<float, 2, 2>;
+	using Matrix3f = FixedMatrix<float, 3, 3>;
+	using Matrix4f = FixedMatrix<float, 4, 4>;
+	using Matrix2d = FixedMatrix<double, 2, 2>;
+	using Matrix3d = FixedMatrix<double, 3, 3>;
+	using Matrix4d = FixedMatrix<double, 4, 4>;
+}
+
+#endif
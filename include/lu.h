@@ -0,0 +1,82 @@
+#ifndef MATRIX_LU_CRYPT_10_10
+#define MATRIX_LU_CRYPT_10_10
+
+#include <vector>
+#include "matrix.h"
+
+namespace m {
+
+	/* PLU factorization with partial pivoting (P * A = L * U) of a square matrix, computed once
+	  in O(n^3) and then reused: every right-hand side costs O(n^2) afterwards. */
+	class LU {
+		public:
+			using value_type		= Matrix::value_type;
+			using length_type		= Matrix::length_type;
+
+			// factors square matrix t_matrix (throws if not square)
+			explicit LU (const Matrix& t_matrix);
+
+			// factors the square block of cells t_matrix looks at (see matrix_view.h; throws if not square)
+			explicit LU (const ConstMatrixView& t_matrix);
+
+			// returns the number of rows (and columns) of the factored matrix
+			length_type size () const;
+
+			// returns true if a zero pivot was met (the matrix has no inverse)
+			bool isSingular () const;
+
+			// returns the determinant of the factored matrix
+			value_type determinant () const;
+
+			// solves A * x = t_b and returns x (throws if singular or sizes don't match)
+			std::vector<value_type> solve (const std::vector<value_type>& t_b) const;
+
+			// solves A * X = t_b for every column of t_b and returns X (throws if singular or rows don't match)
+			Matrix solve (const Matrix& t_b) const;
+			Matrix solve (const ConstMatrixView& t_b) const;
+
+			// solves A * X = t_b for every column of t_b, overwriting t_b with X (throws if singular or rows don't match)
+			void solveInPlace (const MatrixView& t_b) const;
+
+			// returns the inverse of the factored matrix (throws if singular)
+			Matrix inverse () const;
+
+			/* returns L and U packed in one matrix: U on and above the diagonal, L (whose diagonal
+			  is all ones and not stored) below it */
+			const Matrix& factors () const;
+
+			// returns row swaps applied during factoring: row i was swapped with row pivots()[i], in order
+			const std::vector<length_type>& pivots () const;
+
+		private:
+			Matrix m_lu;
+			std::vector<length_type> m_pivots {};
+			bool m_negate {false};		// odd number of row swaps
+			bool m_singular {false};
+
+			void m_factor ();
+			void m_solveInPlace (value_type* t_b, std::size_t t_ldb, length_type t_columns) const;
+	};
+
+	/* direct solvers of t_a * X = t_b: t_a is factored (PLU) and the right-hand sides go through one forward
+	  and one back substitution, so no inverse is formed and nothing is augmented. They throw if t_a isn't
+	  square or is singular, or if the rows of t_b don't match. */
+
+	// overwrites t_b with X
+	void solve (const Matrix& t_a, const MatrixView& t_b);
+	void solve (const ConstMatrixView& t_a, const MatrixView& t_b);
+
+	// returns X
+	Matrix solve (const Matrix& t_a, const Matrix& t_b);
+	std::vector<Matrix::value_type> solve (const Matrix& t_a, const std::vector<Matrix::value_type>& t_b);
+
+	/* triangular solves of T * X = t_b for every column of t_b, overwriting t_b with X. Only the lower (or
+	  upper) triangle of t_t is read, so the packed factors of an LU can be passed as they are; with
+	  t_unit_diagonal the diagonal is taken as ones and not read either. Blocks of rows are substituted one
+	  after the other and the rest of t_b is brought up to date with a GEMM, across the thread pool.
+	  They throw if t_t isn't square, if rows don't match, or if a diagonal cell read is zero. */
+	void solveLower (const ConstMatrixView& t_t, const MatrixView& t_b, bool t_unit_diagonal = false);
+	void solveUpper (const ConstMatrixView& t_t, const MatrixView& t_b, bool t_unit_diagonal = false);
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef MATRIX_MAPPED_CRYPT_10_10
+#define MATRIX_MAPPED_CRYPT_10_10
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "matrix.h"
+
+namespace m {
+
+	/* read-only matrix file written by Matrix::save, mapped into memory instead of read: opening one
+	  costs the same however large the file is, and pages are only read from disk when their cells are
+	  first touched. The cells are reached through view() (see matrix_view.h), which stays valid as
+	  long as the MappedMatrix does. Use Matrix::load for a matrix of its own that can be changed. */
+	class MappedMatrix {
+		public:
+			using value_type		= Matrix::value_type;
+			using length_type		= Matrix::length_type;
+
+			// maps the matrix file at t_path (throws if it can't be opened or isn't a valid matrix file)
+			explicit MappedMatrix (const std::string& t_path);
+
+			// takes over the mapping of t_matrix, leaving it empty
+			MappedMatrix (MappedMatrix&& t_matrix) noexcept;
+			MappedMatrix& operator= (MappedMatrix&& t_matrix) noexcept;
+
+			MappedMatrix (const MappedMatrix&) = delete;
+			MappedMatrix& operator= (const MappedMatrix&) = delete;
+
+			// returns the number of rows
+			length_type getRows () const;
+
+			// returns the number of columns
+			length_type getColumns () const;
+
+			// returns the augmentation seperators stored in the file
+			const std::vector<length_type>& seperators () const;
+
+			// returns a view of the mapped cells
+			ConstMatrixView view () const;
+
+			~MappedMatrix ();
+		private:
+			void* m_map {nullptr};				// the whole file
+			std::size_t m_size {0};				// bytes mapped
+			const value_type* m_cells {nullptr};	// first cell, inside m_map
+			length_type m_rows {0}, m_columns {0};
+			std::size_t m_stride {0};
+			std::vector<length_type> m_seperators {};
+
+			void m_unmap ();
+	};
+}
+
+#endif
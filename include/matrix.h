@@ -2,17 +2,44 @@
 #define MATRIX_CRYPT_10_10
 
 #include <vector>
+#include <atomic>
+#include <string>
 #include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include "matrix_expression.h"
+#include "matrix_view.h"
+#include "matrix_resource.h"
 
 namespace m {
-
-	class Matrix {
+	class Matrix;
+
+	namespace detail {
+		/* mutable view of all of t_matrix for the library to fill: unshared as Matrix::view() is, but not
+		  marked as written through, so copies taken afterwards still hold its buffer. Only for matrices the
+		  library made and hasn't handed a view or pointer of to anyone yet */
+		MatrixView writableView (Matrix& t_matrix);
+	}
+
+	/* const member functions are safe to call on one matrix from many threads at once; changing it is not.
+	  Copies are O(1): a copy holds the cells of the original (the holders are counted atomically, so
+	  copies may go to other threads) and the first change to either one copies them out. A mutable view
+	  or data() pointer gives the matrix cells of its own, which copies made from then on copy instead of
+	  holding, so writes through it never reach another matrix. */
+	class Matrix : public MatrixExpression<Matrix> {
 		public:
 			using value_type		= float;
 			using length_type		= uint32_t;
-			using row_type			= std::vector<value_type>;
-			using matrix_type		= std::vector<row_type>;
 			enum row_op_type {swap, scale, add_multiple};
+			enum class product_type {classical, strassen};	// how products are computed (see setProductType)
+
+			// reads cells of one row, the leaf case of the expression protocol (see matrix_expression.h)
+			struct row_reader {
+				const value_type* row;
+				value_type operator[] (length_type t_column) const { return row[t_column]; }
+			};
+
+			static constexpr std::size_t alignment = 64;	// alignment in bytes of the storage block
 
 			// creates a zero square matrix with t_length rows and columns
 			Matrix (length_type t_length = 1);							
@@ -20,11 +47,27 @@ namespace m {
 			// creates a zero matrix with t_rows rows and t_columns columns
 			Matrix (length_type t_rows, length_type t_columns);					
 			
-			// creates a copty of matrix t_matrix
+			// creates a copy of matrix t_matrix, holding its cells until one of the two is changed
 			Matrix (const Matrix& t_matrix);								
+
+			// takes over the storage of t_matrix, leaving it empty (0x0) until it is assigned to
+			Matrix (Matrix&& t_matrix) noexcept;
+
+			/* same as above, with the buffer taken from t_resource instead of the current one (see matrix_resource.h);
+			  a copy holds the cells of t_matrix only when t_resource is equal to its resource */
+			Matrix (length_type t_rows, length_type t_columns, std::pmr::memory_resource* t_resource);
+			Matrix (const Matrix& t_matrix, std::pmr::memory_resource* t_resource);
 			
-			// creates a copy submatrix of matrix t_matrix for rows within t_i0 and t_i1, and columns with t_j0 and t_j1
+			/* creates a copy submatrix of matrix t_matrix for rows within t_i0 and t_i1, and columns with t_j0 and t_j1
+			  (view() gives the same cells without copying them) */
 			Matrix (const Matrix& t_matrix, length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1);
+
+			// creates a matrix holding the result of an element-wise expression, computed in one pass
+			template <class E>
+			Matrix (const MatrixExpression<E>& t_expression);
+
+			// creates the matrix a transposed view stands for, moving its cells in one blocked pass
+			Matrix (const TransposedView& t_view);
 			
 			// if square, turns matrix into identity matrix
 		   	void identity ();									
@@ -38,6 +81,29 @@ namespace m {
 			// prints a portion of the matrix for rows within t_i0 and t_i1, and columns with t_j0 and t_j1
 			void print (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) const;		
 
+			/* returns a view (see matrix_view.h) of the cells within rows t_i0 and t_i1, and columns t_j0 and t_j1,
+			  without copying them. Writes through the mutable view reach this matrix, so taking one forgets
+			  the determinant. */
+			MatrixView view (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1);
+			ConstMatrixView view (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) const;
+
+			// returns a view of the whole matrix
+			MatrixView view ();
+			ConstMatrixView view () const;
+
+			// returns a view of row t_row
+			MatrixView row (length_type t_row);
+			ConstMatrixView row (length_type t_row) const;
+
+			// returns a view of column t_column
+			MatrixView column (length_type t_column);
+			ConstMatrixView column (length_type t_column) const;
+
+			/* returns a view of augmented section t_index: section 0 runs up to the first seperator, section k
+			  from seperator k - 1 to seperator k (or the last column) */
+			MatrixView section (length_type t_index);
+			ConstMatrixView section (length_type t_index) const;
+
 			// resize the matrix (note: could remove an augmentation seperator if shrank below its index!)
 			void resize (length_type t_new_rows, length_type t_new_columns);				
 
@@ -47,6 +113,14 @@ namespace m {
 			// enters values in the whole matrix
 			void enter ();										
 
+			/* writes the matrix (dimensions, augmentation seperators and cells) to the binary file at t_path,
+			  streaming the buffer out as it lies in memory (format in matrix_file.h; throws on failure) */
+			void save (const std::string& t_path) const;
+
+			/* reads a matrix written by save(). The file is memory-mapped and its cells copied into the new
+			  matrix in one pass; MappedMatrix (see mapped_matrix.h) gives read-only access without the copy. */
+			Matrix static load (const std::string& t_path);
+
 			/* does row operation to the matrix and if determinant exists, it changes it accordingly.
 			for t_operations_type set to:
 			 	* swap			: swaps rows at t_row0 and t_row1 indices and multiplies determinant by -1
@@ -62,10 +136,14 @@ namespace m {
 			// sets the matrix to its reduced echelon form, calculates the determinant and returns the matrix
 			Matrix& reduced_echelon ();							
 																	
-			// sets the matrix to its transpose, and returns it
-			Matrix& transpose ();								
+			/* sets the matrix to its transpose, and returns it. Square matrices are transposed in place; others move
+			  to a new buffer, or, from m_in_place_transpose cells on, are permuted within the one they have */
+			Matrix& transpose ();
+
+			// returns the transpose of the matrix in O(1) without moving a cell (see TransposedView)
+			TransposedView transposed () const;								
 
-			// sets the matrix to its inverse, and returns it
+			// sets the matrix to its inverse (through an LU factorization, see lu.h), and returns it
 			Matrix& invert ();									
 
 			// creates augment t_matrix to the end of current matrix if number of rows match in both
@@ -99,54 +177,262 @@ namespace m {
 			// returns the number of columns
 			length_type getColumns () const;					
 
-			// returns the determinant if there is
+			/* returns the determinant if there is (throws if rows != columns). It is computed on the first call and
+			  kept; threads calling this on the same const matrix at once compute it only once, the rest wait */
 			value_type getDeterminant () const;					
 
 			// adds matrix t_matrix to this matrix and returns it
 			Matrix& add (const Matrix& t_matrix);						
+			Matrix& add (const ConstMatrixView& t_view);
 
-			// multiplies matrix t_matrix by this matrix and returns it
+			/* multiplies matrix t_matrix by this matrix and returns it. The product is computed into a
+			  per-thread scratch buffer that is then swapped with this matrix's one (unless other matrices
+			  hold it), so repeating the call on same-sized matrices does not allocate. */
 			Matrix& multiply (const Matrix& t_matrix);					
+			Matrix& multiply (const ConstMatrixView& t_view);
 
-			// copy-assignment
+			/* copy-assignment, holding the cells of t_matrix as the copy constructor does (when the resources
+			  differ, they are copied into the current buffer if it is large enough) */
 			Matrix& operator= (const Matrix& t_matrix);					
 
-			// returns copty of the matrix with values multiplied by -1
-			Matrix operator- () const;							
+			// move-assignment
+			Matrix& operator= (Matrix&& t_matrix) noexcept;
+
+			// in-place element-wise updates of the existing buffer, no allocation
+			template <class E>
+			Matrix& operator+= (const MatrixExpression<E>& t_expression);
+			template <class E>
+			Matrix& operator-= (const MatrixExpression<E>& t_expression);
+			Matrix& operator*= (value_type t_constant);
+
+			// same as multiply
+			Matrix& operator*= (const Matrix& t_matrix);
+			Matrix& operator*= (const ConstMatrixView& t_view);
+
+			/* evaluates an element-wise expression straight into this matrix in one pass (the buffer is
+			  reused when dimensions match, and the matrix may appear in the expression itself).
+			  Unary -, +, - and scaling by a constant (see matrix_expression.h) build such expressions,
+			  so A = B + C * 2.0f - D allocates nothing but A and sweeps memory once. */
+			template <class E>
+			Matrix& operator= (const MatrixExpression<E>& t_expression);
+
+			/* multiplies the two matrices into a new one and returns it (throws if columns
+			  of first != rows of second) */
+			Matrix operator* (const Matrix& t_matrix) const;				
+			Matrix operator* (const ConstMatrixView& t_view) const;
+			Matrix operator* (const TransposedView& t_view) const;
 
-			/* adds the two matrices into a new one and returns it (if same dimentions,
-			  returns 1x1 zero matrix otherwise) */
-			Matrix operator+ (const Matrix& t_matrix) const;				
+			// sets precision of values in the matrix to t_precision
+			void static setPrecision(int t_precision);					
 
-			/* subtracts the two matrices into a new one and returns it (if same dimentions,
-			  returns 1x1 zero matrix otherwise) */
-			Matrix operator- (const Matrix& t_matrix) const;				
-																	
+			// returns precision of values printed
+			int static getPrecision();
 
-			/* multiplies the two matrices into a new one and returns it (if columns
-			  of first = rows of second, returns 1x1 zero matrix otherwise) */
-			Matrix operator* (const Matrix& t_matrix) const;				
-																	
+			/* sets the number of threads matrix operations may use, the calling one included (0 picks the
+			  hardware concurrency). Multiplication, addition, subtraction, scaling and transposition split
+			  their work across them once the matrices are large enough; small ones stay on one thread.
+			  Must not be called while another thread is running matrix operations. */
+			void static setThreads(unsigned t_threads);
 
-			// multiplies the matrix by t_constant value into a new matrix and returns it
-			Matrix operator* (const value_type t_constant) const;			
+			// returns the number of threads matrix operations may use
+			unsigned static getThreads();
 
-			// sets precision of values in the matrix to t_precision
-			void static setPrecision(int t_precision);					
+			/* sets how products of matrices and views are computed from now on (m::product picks it per call).
+			  product_type::strassen uses the Strassen-Winograd recursion down to blocks whose smallest side
+			  is the crossover, which does about 7/8 of the multiply-adds of the classical product per level
+			  and pays off on products of thousands of rows and columns. It is less accurate: the error bound
+			  grows by a factor of about 18 per level (normwise, |C - AB| <= c(n) 18^levels u |A| |B|, where
+			  the classical product has n u |A| |B|), which in practice costs a decimal digit every two or
+			  three levels. Products with a transposed operand stay classical. Must not be called while
+			  another thread is running matrix operations. */
+			void static setProductType(product_type t_type);
+
+			// returns how products are computed
+			product_type static getProductType();
+
+			// sets the side from which Strassen-Winograd products split blocks further (throws if below 32)
+			void static setStrassenCrossover(length_type t_crossover);
+
+			// returns the side from which Strassen-Winograd products split blocks further
+			length_type static getStrassenCrossover();
+
+			// returns the resource the buffer of the matrix comes from and goes back to
+			std::pmr::memory_resource* getResource () const;
+
+			// returns the number of matrices alive (see matrix_stats.h for what they are doing)
+			length_type static getMatricesCount();
+
+			/* returns pointer to the first cell of the storage. Cells are kept in one contiguous,
+			  64-byte aligned row-major block where cell [i][j] is at data()[i * stride() + j].
+			  The non-const overload forgets the determinant, as cells may be written through it. */
+			value_type* data ();
+			const value_type* data () const;
+
+			// returns the leading dimension (number of cells between the starts of two consecutive rows)
+			length_type stride () const;
+
+			// returns a reader over row t_row (expression protocol)
+			row_reader reader (length_type t_row) const { return {m_row(t_row)}; }
 
 			
 			~Matrix ();
 		private:
-			matrix_type m_matrix {};
+			value_type * m_data {nullptr};			// row-major block of m_rows * m_stride cells
 			length_type m_rows {0}, m_columns {0};
+			length_type m_stride {0};				// leading dimension, m_columns padded to keep rows aligned
+			std::size_t m_capacity {0};				// cells m_data has room for (at least m_rows * m_stride)
 			std::vector<length_type> m_aug_sep {};	// it stores indices of columns at which matrix is augmented
-			value_type * m_determinant {nullptr};	// if nullptr, then there is no determinant (Eg. rows != columns)
+			std::pmr::memory_resource* m_resource {currentResource()};	// where m_data comes from
+			// the determinant, valid while m_determinant_state is m_known (filled in by const getDeterminant)
+			mutable value_type m_determinant {0};
+			enum m_determinant_states : unsigned char {m_unknown, m_computing, m_known};
+			mutable std::atomic<unsigned char> m_determinant_state {m_unknown};
 
-			static length_type m_matrices_count;
+			static std::atomic<length_type> m_matrices_count;
 			static int m_precision;
+			static product_type m_product_type;
+			static length_type m_strassen_crossover;
+
+			struct m_no_fill {};
+			Matrix (length_type t_rows, length_type t_columns, m_no_fill);	// storage is left uninitialized
 
 			void m_defaultConstruct ();				// creates 1x1 zero matrix
+			// sets up storage for t_rows x t_columns, zeroed when t_zero is set
+			void m_allocate (length_type t_rows, length_type t_columns, bool t_zero = true);
+			void m_release ();						// frees the storage (or lets go of it, if others hold it too)
+			bool m_shared () const;					// whether other matrices hold m_data too
+			// gives the matrix a buffer nobody else holds, with the cells copied over when t_keep is set
+			void m_unshare (bool t_keep = true);
+			void m_leak ();							// unshares the buffer and marks it as written through views or pointers
+			bool m_shareable (const Matrix& t_matrix) const;	// whether a copy of t_matrix may hold its buffer
+			void m_share (const Matrix& t_matrix);	// holds the buffer of t_matrix (the current one must be let go)
+
+			friend MatrixView detail::writableView (Matrix& t_matrix);
+			void m_dropDeterminant ();
+			void m_setDeterminant (value_type t_determinant);
+			bool m_hasDeterminant () const { return m_determinant_state.load(std::memory_order_acquire) == m_known; }
+			value_type m_computeDeterminant () const;
+			value_type* m_row (length_type t_row) { return m_data + std::size_t(t_row) * m_stride; }
+			const value_type* m_row (length_type t_row) const { return m_data + std::size_t(t_row) * m_stride; }
+			// first and last column of augmented section t_index (throws if there is no such section)
+			void m_sectionBounds (length_type t_index, length_type& t_first, length_type& t_last) const;
+
+			static constexpr length_type m_elimination_block = 64;		// columns eliminated per panel in echelon()
+			// cells (64 MB) from which non square transposes permute in place instead of taking a second buffer
+			static constexpr std::size_t m_in_place_transpose = std::size_t(1) << 24;
+
+			static length_type m_alignedStride (length_type t_columns);
+			// a buffer of t_count cells held once; letting go of it frees it with the last holder
+			value_type* m_allocateBuffer (std::size_t t_count) const;
+			void m_freeBuffer (value_type* t_buffer, std::size_t t_count) const;
 	};
+
+	namespace detail {
+		// dense operands of a product: matrices and views are used where they are, other expressions are evaluated first
+		inline ConstMatrixView materialize (const Matrix& t_matrix) { return t_matrix.view(); }
+		inline ConstMatrixView materialize (const ConstMatrixView& t_view) { return t_view; }
+
+		template <class E>
+		Matrix materialize (const MatrixExpression<E>& t_expression) { return Matrix(t_expression); }
+
+		// dense operand of a product as gemm takes it: cell (i, k) is at data[i * row_stride + k * column_stride]
+		struct ProductOperand {
+			const float* data;
+			std::size_t row_stride, column_stride;
+			uint32_t rows, columns;
+		};
+
+		inline ProductOperand productOperand (const ConstMatrixView& t_view) {
+			return {t_view.data(), t_view.stride(), 1, t_view.getRows(), t_view.getColumns()};
+		}
+		inline ProductOperand productOperand (const Matrix& t_matrix) { return productOperand(t_matrix.view()); }
+		inline ProductOperand productOperand (const TransposedView& t_view) {
+			const ConstMatrixView& cells = t_view.transposed();
+			return {cells.data(), 1, cells.stride(), t_view.getRows(), t_view.getColumns()};
+		}
+
+		// returns t_left * t_right (throws if columns of first != rows of second)
+		Matrix product (const ProductOperand& t_left, const ProductOperand& t_right,
+				Matrix::product_type t_type = Matrix::getProductType());
+	}
+
+	// scaling a matrix; spelled out so it wins over Matrix::operator* converting t_constant to a matrix
+	inline MatrixScaled<Matrix> operator* (const Matrix& t_matrix, Matrix::value_type t_constant) {
+		return MatrixScaled<Matrix>(t_matrix, t_constant);
+	}
+
+	inline MatrixScaled<Matrix> operator* (Matrix::value_type t_constant, const Matrix& t_matrix) {
+		return MatrixScaled<Matrix>(t_matrix, t_constant);
+	}
+
+	/* matrix product where the left side is a view or an expression (a matrix on the left is handled by
+	  Matrix::operator*); views are multiplied in place, other expressions are evaluated first */
+	template <class L, class R, class = typename std::enable_if<!std::is_same<L, Matrix>::value>::type>
+	Matrix operator* (const MatrixExpression<L>& t_left, const MatrixExpression<R>& t_right) {
+		const auto& left = detail::materialize(t_left.self());
+		const auto& right = detail::materialize(t_right.self());
+		return detail::product(detail::productOperand(left), detail::productOperand(right));
+	}
+
+	// returns t_left * t_right computed the way t_type says, whatever Matrix::setProductType picked (throws as operator* does)
+	inline Matrix product (const Matrix& t_left, const Matrix& t_right, Matrix::product_type t_type) {
+		return detail::product(detail::productOperand(t_left), detail::productOperand(t_right), t_type);
+	}
+	inline Matrix product (const ConstMatrixView& t_left, const ConstMatrixView& t_right, Matrix::product_type t_type) {
+		return detail::product(detail::productOperand(t_left), detail::productOperand(t_right), t_type);
+	}
+
+	// products with a transposed operand, which is read in place
+	inline Matrix operator* (const TransposedView& t_left, const TransposedView& t_right) {
+		return detail::product(detail::productOperand(t_left), detail::productOperand(t_right));
+	}
+
+	template <class R>
+	Matrix operator* (const TransposedView& t_left, const MatrixExpression<R>& t_right) {
+		const auto& right = detail::materialize(t_right.self());
+		return detail::product(detail::productOperand(t_left), detail::productOperand(right));
+	}
+
+	template <class L, class = typename std::enable_if<!std::is_same<L, Matrix>::value>::type>
+	Matrix operator* (const MatrixExpression<L>& t_left, const TransposedView& t_right) {
+		const auto& left = detail::materialize(t_left.self());
+		return detail::product(detail::productOperand(left), detail::productOperand(t_right));
+	}
+
+	template <class E>
+	Matrix::Matrix (const MatrixExpression<E>& t_expression)
+			: Matrix(t_expression.self().getRows(), t_expression.self().getColumns(), m_no_fill{}) {
+		M_INSTRUMENT_EXPRESSION(E, double(m_rows) * m_columns);
+		detail::evaluate(m_data, m_stride, m_rows, m_columns, t_expression.self());
+	}
+
+	template <class E>
+	Matrix& Matrix::operator= (const MatrixExpression<E>& t_expression) {
+		const E& expression = t_expression.self();
+		length_type rows = expression.getRows(), columns = expression.getColumns();
+		if (rows != m_rows || columns != m_columns || m_shared()) {
+			// the expression may read this matrix, so the old buffer lives until evaluation is done
+			*this = Matrix(expression);
+			return *this;
+		}
+		M_INSTRUMENT_EXPRESSION(E, double(m_rows) * m_columns);
+		detail::evaluate(m_data, m_stride, m_rows, m_columns, expression);
+		m_dropDeterminant();
+		if (!m_aug_sep.empty()) m_aug_sep.clear();
+		return *this;
+	}
+
+	template <class E>
+	Matrix& Matrix::operator+= (const MatrixExpression<E>& t_expression) {
+		*this = *this + t_expression;
+		return *this;
+	}
+
+	template <class E>
+	Matrix& Matrix::operator-= (const MatrixExpression<E>& t_expression) {
+		*this = *this - t_expression;
+		return *this;
+	}
 }
 
 #endif
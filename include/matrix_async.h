@@ -0,0 +1,232 @@
+#ifndef MATRIX_ASYNC_CRYPT_10_10
+#define MATRIX_ASYNC_CRYPT_10_10
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "matrix.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define M_ASYNC_COROUTINES 1
+#endif
+
+namespace m {
+	namespace async {
+
+		/* asynchronous matrix operations: each call returns at once with a Future of its result, and its
+		  operands may be futures of earlier calls, so the calls of a computation form a graph of tasks. A
+		  task goes to the library thread pool (see Matrix::setThreads) once its operands are ready, so tasks
+		  that don't depend on each other run at the same time:
+
+			Future<Matrix> ab = async::multiply(a, b), cd = async::multiply(c, d);		// run concurrently
+			Future<Matrix> res = async::invert(async::add(ab, cd));						// once both are done
+
+		  Matrices passed are copied (see Matrix), so they may be changed meanwhile, views included. An
+		  exception thrown by a task is kept in its future, and passed on to every task depending on it. With
+		  a single thread every task runs as soon as it may, on the thread making it ready. */
+
+		template <class T>
+		class Future;
+
+		namespace detail {
+			// queues t_task on the library thread pool
+			void schedule (std::function<void ()> t_task);
+
+			// returns a function calling t_start on its t_count-th call (t_start is called right away for 0)
+			std::function<void ()> countdown (std::size_t t_count, std::function<void ()> t_start);
+
+			// what a future refers to, less the result: whether it is ready, an exception, and who waits for it
+			class StateBase {
+				public:
+					StateBase () = default;
+					StateBase (const StateBase&) = delete;
+					StateBase& operator= (const StateBase&) = delete;
+					virtual ~StateBase () = default;
+
+					bool ready () const;
+
+					// returns once ready, running queued pool tasks meanwhile (the one waited for may be among them)
+					void wait () const;
+
+					// calls t_continuation once ready (right away if it is), on the thread that made it so
+					void onReady (std::function<void ()> t_continuation);
+
+					// makes it ready with t_error, which the result stands for from now on
+					void fail (std::exception_ptr t_error);
+
+					// rethrows the exception it is ready with, if any
+					void rethrow () const;
+
+				protected:
+					void m_complete ();		// makes it ready and calls the continuations
+
+				private:
+					mutable std::mutex m_mutex {};
+					mutable std::condition_variable m_done {};
+					std::vector<std::function<void ()>> m_continuations {};
+					std::atomic<bool> m_ready {false};
+					std::exception_ptr m_error {};
+			};
+
+			template <class T>
+			class State : public StateBase {
+				public:
+					void set (T t_value) {
+						m_value.emplace(std::move(t_value));
+						m_complete();
+					}
+					const T& value () const {
+						rethrow();
+						return *m_value;
+					}
+				private:
+					std::optional<T> m_value {};
+			};
+		}
+
+		/* the result of an asynchronous operation, shared by every copy of the future. get() waits for it,
+		  then() and when_all() make tasks that wait for it without blocking anybody */
+		template <class T>
+		class Future {
+			public:
+				static_assert(!std::is_void<T>::value, "Futures hold a result!");
+				using value_type = T;
+
+				// creates a future that stands for nothing (valid() is false)
+				Future () = default;
+
+				// creates a future ready with t_value, so values can be passed where futures are taken
+				Future (T t_value) : m_state(std::make_shared<detail::State<T>>()) {
+					m_state->set(std::move(t_value));
+				}
+
+				// returns whether the future stands for a result
+				bool valid () const { return m_state != nullptr; }
+
+				// returns whether the result (or the exception thrown instead) is there
+				bool ready () const { return m_state->ready(); }
+
+				// returns once the result is there, running queued pool tasks meanwhile
+				void wait () const { m_state->wait(); }
+
+				// returns the result once it is there, or rethrows the exception thrown instead
+				const T& get () const {
+					m_state->wait();
+					return m_state->value();
+				}
+
+				/* returns the future of t_function(result), called on the pool once the result is there (an
+				  exception thrown instead is passed on, and t_function isn't called) */
+				template <class F>
+				auto then (F t_function) const;
+
+				/* calls t_continuation once the result is there (right away if it is), on the thread that made
+				  it so; it should only hand work on, as that thread may be the one that was computing it */
+				void onReady (std::function<void ()> t_continuation) const { m_state->onReady(std::move(t_continuation)); }
+
+			private:
+				std::shared_ptr<detail::State<T>> m_state {};
+
+				template <class F, class... Ts>
+				friend auto run (F t_function, const Future<Ts>&... t_operands);
+				template <class U>
+				friend Future<std::vector<U>> when_all (const std::vector<Future<U>>& t_futures);
+		};
+
+		/* returns the future of t_function(results of t_operands...), called on the pool once all of them are
+		  there. An exception one of them holds is passed on instead, and t_function isn't called */
+		template <class F, class... Ts>
+		auto run (F t_function, const Future<Ts>&... t_operands) {
+			using result_type = std::decay_t<std::invoke_result_t<F&, const Ts&...>>;
+			Future<result_type> res;
+			res.m_state = std::make_shared<detail::State<result_type>>();
+			std::shared_ptr<detail::State<result_type>> state = res.m_state;
+			std::tuple<Future<Ts>...> operands(t_operands...);
+			auto start = [state, t_function, operands] () {
+				detail::schedule([state, t_function, operands] () mutable {
+					try {
+						state->set(std::apply([&t_function] (const Future<Ts>&... t_ready) {
+							return t_function(t_ready.get()...);
+						}, operands));
+					}
+					catch (...) { state->fail(std::current_exception()); }
+				});
+			};
+			std::function<void ()> arrive = detail::countdown(sizeof...(Ts), start);
+			(t_operands.onReady(arrive), ...);
+			return res;
+		}
+
+		template <class T>
+		template <class F>
+		auto Future<T>::then (F t_function) const {
+			return run(std::move(t_function), *this);
+		}
+
+		// returns the future of the results of all of t_futures, ready once every one of them is
+		template <class... Ts>
+		Future<std::tuple<Ts...>> when_all (const Future<Ts>&... t_futures) {
+			return run([] (const Ts&... t_values) { return std::tuple<Ts...>(t_values...); }, t_futures...);
+		}
+
+		template <class T>
+		Future<std::vector<T>> when_all (const std::vector<Future<T>>& t_futures) {
+			Future<std::vector<T>> res;
+			res.m_state = std::make_shared<detail::State<std::vector<T>>>();
+			std::shared_ptr<detail::State<std::vector<T>>> state = res.m_state;
+			std::function<void ()> arrive = detail::countdown(t_futures.size(), [state, t_futures] () {
+				detail::schedule([state, t_futures] () {
+					try {
+						std::vector<T> values;
+						values.reserve(t_futures.size());
+						for (const Future<T>& future : t_futures) values.push_back(future.get());
+						state->set(std::move(values));
+					}
+					catch (...) { state->fail(std::current_exception()); }
+				});
+			});
+			for (const Future<T>& future : t_futures) future.onReady(arrive);
+			return res;
+		}
+
+		// matrix operations, each returning as soon as its task is made (they throw from get() as the blocking ones do)
+		Future<Matrix> multiply (const Future<Matrix>& t_left, const Future<Matrix>& t_right);
+		Future<Matrix> add (const Future<Matrix>& t_left, const Future<Matrix>& t_right);
+		Future<Matrix> subtract (const Future<Matrix>& t_left, const Future<Matrix>& t_right);
+		Future<Matrix> scale (const Future<Matrix>& t_matrix, Matrix::value_type t_constant);
+		Future<Matrix> transpose (const Future<Matrix>& t_matrix);
+		Future<Matrix> invert (const Future<Matrix>& t_matrix);
+		Future<Matrix::value_type> determinant (const Future<Matrix>& t_matrix);
+
+		// solves t_a * X = t_b (see m::solve in lu.h)
+		Future<Matrix> solve (const Future<Matrix>& t_a, const Future<Matrix>& t_b);
+
+#ifdef M_ASYNC_COROUTINES
+		/* C++20: co_await on a future suspends the coroutine until the result is there, then resumes it on
+		  the pool with a copy of the result (or the exception thrown instead) */
+		template <class T>
+		auto operator co_await (const Future<T>& t_future) {
+			struct Awaiter {
+				Future<T> future;
+				bool await_ready () const { return future.ready(); }
+				void await_suspend (std::coroutine_handle<> t_handle) const {
+					future.onReady([t_handle] { detail::schedule([t_handle] { t_handle.resume(); }); });
+				}
+				T await_resume () const { return future.get(); }
+			};
+			return Awaiter {t_future};
+		}
+#endif
+	}
+}
+
+#endif
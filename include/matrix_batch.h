@@ -0,0 +1,89 @@
+#ifndef MATRIX_BATCH_CRYPT_10_10
+#define MATRIX_BATCH_CRYPT_10_10
+
+#include <vector>
+#include <cstddef>
+#include "matrix.h"
+
+namespace m {
+
+	/* many matrices of the same small shape (up to max_length rows and columns), stored cell by cell:
+	  the values of cell (i, j) of every matrix in the batch sit next to each other, so one vector
+	  instruction works on that cell of 8 matrices at once (AVX2 where the cpu has it). Operations pair the
+	  matrices by index, are split across threads (see Matrix::setThreads), and do exactly the arithmetic
+	  Matrix does for one matrix, in the same order: results are bit for bit those of Matrix::operator*,
+	  getDeterminant(), invert() and LU::solve(), as long as the build doesn't fuse multiply-adds. */
+	class MatrixBatch {
+		public:
+			using value_type		= Matrix::value_type;
+			using length_type		= Matrix::length_type;
+
+			static constexpr length_type max_length = 16;		// largest number of rows or columns
+
+			// creates t_count zero matrices of t_rows rows and t_columns columns
+			MatrixBatch (std::size_t t_count, length_type t_rows, length_type t_columns);
+
+			// creates a batch holding copies of t_matrices (throws if empty or their dimensions differ)
+			explicit MatrixBatch (const std::vector<Matrix>& t_matrices);
+
+			MatrixBatch (const MatrixBatch& t_batch);
+			MatrixBatch (MatrixBatch&& t_batch) noexcept;
+			MatrixBatch& operator= (const MatrixBatch& t_batch);
+			MatrixBatch& operator= (MatrixBatch&& t_batch) noexcept;
+			~MatrixBatch ();
+
+			// returns the number of matrices
+			std::size_t size () const;
+
+			// returns the number of rows of every matrix
+			length_type getRows () const;
+
+			// returns the number of columns of every matrix
+			length_type getColumns () const;
+
+			// returns value of cell at t_row and t_column of matrix t_index (throws if out of bound)
+			value_type getCell (std::size_t t_index, length_type t_row, length_type t_column) const;
+
+			// sets value of cell at t_row and t_column of matrix t_index (throws if out of bound)
+			void setCell (std::size_t t_index, length_type t_row, length_type t_column, value_type t_value);
+
+			// returns a copy of matrix t_index (throws if out of bound)
+			Matrix get (std::size_t t_index) const;
+
+			// copies t_matrix into matrix t_index (throws if out of bound or dimensions don't match)
+			void set (std::size_t t_index, const Matrix& t_matrix);
+
+			/* returns the size() values of cell (t_row, t_column), one per matrix, for filling or reading a
+			  batch a cell at a time (throws if out of bound) */
+			value_type* cell (length_type t_row, length_type t_column);
+			const value_type* cell (length_type t_row, length_type t_column) const;
+
+			// returns the products this[k] * t_batch[k] (throws if sizes or dimensions don't match)
+			MatrixBatch operator* (const MatrixBatch& t_batch) const;
+
+			// sets every matrix to its transpose and returns the batch
+			MatrixBatch& transpose ();
+
+			// returns the determinant of every matrix (throws if not square)
+			std::vector<value_type> determinants () const;
+
+			/* sets every matrix to its inverse and returns how many had none (throws if not square). Those
+			  are left holding infinities or NaNs, and are marked in *t_singular when it is given. */
+			std::size_t invert (std::vector<bool>* t_singular = nullptr);
+
+			/* returns X[k] solving this[k] * X[k] = t_b[k] for every k (throws if not square or sizes don't
+			  match); singular matrices are handled as in invert() */
+			MatrixBatch solve (const MatrixBatch& t_b, std::vector<bool>* t_singular = nullptr) const;
+
+		private:
+			std::size_t m_count, m_lanes;		// m_lanes: m_count rounded up to whole 64 byte blocks
+			length_type m_rows, m_columns;
+			value_type* m_data;
+
+			std::size_t m_cell (std::size_t t_index, length_type t_row, length_type t_column) const;
+			std::size_t m_solve (const value_type* t_b, value_type* t_x, length_type t_columns,
+					std::vector<bool>* t_singular) const;
+	};
+}
+
+#endif
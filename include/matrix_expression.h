@@ -0,0 +1,202 @@
+#ifndef MATRIX_EXPRESSION_CRYPT_10_10
+#define MATRIX_EXPRESSION_CRYPT_10_10
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include "matrix_stats.h"
+
+namespace m {
+
+	class Matrix;
+
+	/* base of everything that can stand on either side of an element-wise operator. E provides
+	  getRows(), getColumns() and reader(i), which returns a cheap row_reader whose [j] gives cell (i, j).
+	  Operators on expressions build nodes instead of matrices; nothing is computed until a node is
+	  assigned to (or used to construct) a Matrix, which then fills itself in a single pass. */
+	template <class E>
+	class MatrixExpression {
+		public:
+			const E& self () const { return static_cast<const E&>(*this); }
+		protected:
+			MatrixExpression () = default;
+			MatrixExpression (const MatrixExpression&) = default;
+			MatrixExpression& operator= (const MatrixExpression&) = default;
+			~MatrixExpression () = default;
+	};
+
+	namespace detail {
+		// matrices are held by reference inside nodes, nodes (usually temporaries) by value
+		template <class E> struct expression_operand { using type = const E; };
+		template <> struct expression_operand<Matrix> { using type = const Matrix&; };
+
+		constexpr std::size_t parallel_cells = 1 << 15;	// element-wise work on fewer cells stays on the calling thread
+
+		// calls t_body(first_row, last_row) over blocks of [0, t_rows), across threads when worth it (matrix.cpp)
+		void forRowBlocks (uint32_t t_rows, uint32_t t_columns, const std::function<void (uint32_t, uint32_t)>& t_body);
+
+		/* writes cell (i, j) of t_expression to t_out[i * t_stride + j] in one pass. Every node reads cell (i, j)
+		  of its operands only to produce cell (i, j), so t_out may be one of the operands. */
+		template <class E>
+		void evaluate (float* t_out, std::size_t t_stride, uint32_t t_rows, uint32_t t_columns, const E& t_expression) {
+			auto body = [=, &t_expression] (uint32_t t_first, uint32_t t_last) {
+				for (uint32_t i = t_first; i < t_last; i++) {
+					float* out = t_out + std::size_t(i) * t_stride;
+					auto in = t_expression.reader(i);
+					for (uint32_t j = 0; j < t_columns; j++)
+						out[j] = in[j];
+				}
+			};
+			if (std::size_t(t_rows) * t_columns < parallel_cells) body(0, t_rows);
+			else forRowBlocks(t_rows, t_columns, body);
+		}
+	}
+
+	// node for t_left + t_right
+	template <class L, class R>
+	class MatrixSum : public MatrixExpression<MatrixSum<L, R>> {
+		public:
+			using value_type		= float;
+			using length_type		= uint32_t;
+
+			struct row_reader {
+				typename L::row_reader left;
+				typename R::row_reader right;
+				value_type operator[] (length_type t_column) const { return left[t_column] + right[t_column]; }
+			};
+
+			MatrixSum (const L& t_left, const R& t_right) : m_left(t_left), m_right(t_right) {
+				if (t_left.getRows() != t_right.getRows() || t_left.getColumns() != t_right.getColumns())
+					throw ("Matrices couldn't be added!");
+			}
+			length_type getRows () const { return m_left.getRows(); }
+			length_type getColumns () const { return m_left.getColumns(); }
+			row_reader reader (length_type t_row) const { return {m_left.reader(t_row), m_right.reader(t_row)}; }
+		private:
+			typename detail::expression_operand<L>::type m_left;
+			typename detail::expression_operand<R>::type m_right;
+	};
+
+	// node for t_left - t_right
+	template <class L, class R>
+	class MatrixDifference : public MatrixExpression<MatrixDifference<L, R>> {
+		public:
+			using value_type		= float;
+			using length_type		= uint32_t;
+
+			struct row_reader {
+				typename L::row_reader left;
+				typename R::row_reader right;
+				value_type operator[] (length_type t_column) const { return left[t_column] - right[t_column]; }
+			};
+
+			MatrixDifference (const L& t_left, const R& t_right) : m_left(t_left), m_right(t_right) {
+				if (t_left.getRows() != t_right.getRows() || t_left.getColumns() != t_right.getColumns())
+					throw ("Matrices couldn't be subtracted!");
+			}
+			length_type getRows () const { return m_left.getRows(); }
+			length_type getColumns () const { return m_left.getColumns(); }
+			row_reader reader (length_type t_row) const { return {m_left.reader(t_row), m_right.reader(t_row)}; }
+		private:
+			typename detail::expression_operand<L>::type m_left;
+			typename detail::expression_operand<R>::type m_right;
+	};
+
+	// node for -t_operand
+	template <class E>
+	class MatrixNegation : public MatrixExpression<MatrixNegation<E>> {
+		public:
+			using value_type		= float;
+			using length_type		= uint32_t;
+
+			struct row_reader {
+				typename E::row_reader operand;
+				value_type operator[] (length_type t_column) const { return -operand[t_column]; }
+			};
+
+			explicit MatrixNegation (const E& t_operand) : m_operand(t_operand) {}
+			length_type getRows () const { return m_operand.getRows(); }
+			length_type getColumns () const { return m_operand.getColumns(); }
+			row_reader reader (length_type t_row) const { return {m_operand.reader(t_row)}; }
+		private:
+			typename detail::expression_operand<E>::type m_operand;
+	};
+
+	// node for t_operand * t_constant
+	template <class E>
+	class MatrixScaled : public MatrixExpression<MatrixScaled<E>> {
+		public:
+			using value_type		= float;
+			using length_type		= uint32_t;
+
+			struct row_reader {
+				typename E::row_reader operand;
+				value_type constant;
+				value_type operator[] (length_type t_column) const { return operand[t_column] * constant; }
+			};
+
+			MatrixScaled (const E& t_operand, value_type t_constant) : m_operand(t_operand), m_constant(t_constant) {}
+			length_type getRows () const { return m_operand.getRows(); }
+			length_type getColumns () const { return m_operand.getColumns(); }
+			row_reader reader (length_type t_row) const { return {m_operand.reader(t_row), m_constant}; }
+		private:
+			typename detail::expression_operand<E>::type m_operand;
+			value_type m_constant;
+	};
+
+	// adds two expressions of the same dimensions (throws otherwise)
+	template <class L, class R>
+	MatrixSum<L, R> operator+ (const MatrixExpression<L>& t_left, const MatrixExpression<R>& t_right) {
+		return MatrixSum<L, R>(t_left.self(), t_right.self());
+	}
+
+	// subtracts two expressions of the same dimensions (throws otherwise)
+	template <class L, class R>
+	MatrixDifference<L, R> operator- (const MatrixExpression<L>& t_left, const MatrixExpression<R>& t_right) {
+		return MatrixDifference<L, R>(t_left.self(), t_right.self());
+	}
+
+	// multiplies every cell by -1
+	template <class E>
+	MatrixNegation<E> operator- (const MatrixExpression<E>& t_operand) {
+		return MatrixNegation<E>(t_operand.self());
+	}
+
+	// multiplies every cell by t_constant
+	template <class E>
+	MatrixScaled<E> operator* (const MatrixExpression<E>& t_operand, float t_constant) {
+		return MatrixScaled<E>(t_operand.self(), t_constant);
+	}
+
+	template <class E>
+	MatrixScaled<E> operator* (float t_constant, const MatrixExpression<E>& t_operand) {
+		return MatrixScaled<E>(t_operand.self(), t_constant);
+	}
+
+	namespace detail {
+		/* what evaluating an expression counts as in the statistics (see matrix_stats.h), going by its root
+		  node: a leaf (matrix or view) is a copy, a sum or difference an add, a negation or scaling a scale.
+		  Flops and bytes are per cell */
+		template <class E>
+		struct expression_cost {
+			static constexpr stats::operation_type operation = stats::copy;
+			static constexpr double flops = 0, bytes = 2 * sizeof(float);
+		};
+		template <class L, class R>
+		struct expression_cost<MatrixSum<L, R>> {
+			static constexpr stats::operation_type operation = stats::add;
+			static constexpr double flops = 1, bytes = 3 * sizeof(float);
+		};
+		template <class L, class R>
+		struct expression_cost<MatrixDifference<L, R>> : expression_cost<MatrixSum<L, R>> {};
+		template <class E>
+		struct expression_cost<MatrixScaled<E>> {
+			static constexpr stats::operation_type operation = stats::scale;
+			static constexpr double flops = 1, bytes = 2 * sizeof(float);
+		};
+		template <class E>
+		struct expression_cost<MatrixNegation<E>> : expression_cost<MatrixScaled<E>> {};
+	}
+}
+
+#endif
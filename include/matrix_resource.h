@@ -0,0 +1,63 @@
+#ifndef MATRIX_RESOURCE_CRYPT_10_10
+#define MATRIX_RESOURCE_CRYPT_10_10
+
+#include <cstddef>
+#include <vector>
+#include <memory_resource>
+
+namespace m {
+
+	/* where matrix buffers come from. A Matrix takes its buffer from a std::pmr::memory_resource and gives
+	  it back there: the one passed to its constructor, or else the one current on the creating thread (for
+	  copies too, as pmr containers do). A matrix keeps its resource for life: assignment and resizing reuse
+	  it, moves carry it along. Temporaries of operators, invert, LU and the solvers are matrices created on
+	  the calling thread, so they take their buffers from the current resource as well. */
+
+	// returns the resource matrices created on this thread take their buffers from (by default std::pmr::get_default_resource())
+	std::pmr::memory_resource* currentResource ();
+
+	/* makes t_resource current on this thread while it lives, then puts the previous one back. Matrices
+	  created meanwhile must not outlive t_resource */
+	class ResourceScope {
+		public:
+			explicit ResourceScope (std::pmr::memory_resource* t_resource);
+			ResourceScope (const ResourceScope&) = delete;
+			ResourceScope& operator= (const ResourceScope&) = delete;
+			~ResourceScope ();
+		private:
+			std::pmr::memory_resource* m_previous;
+	};
+
+	/* per-thread pool of matrix buffers for a block of work, current on the creating thread while it lives.
+	  Freed buffers are kept by size class (four per power of two, so at most a quarter is wasted) and handed
+	  out again, so a loop of operations stops reaching the heap after its first round, and no lock is ever
+	  taken. Every matrix created while it lives must be gone before it is destroyed and be used by this
+	  thread only; a result meant to outlive it is copied out with Matrix(result, std::pmr::new_delete_resource()). */
+	class MatrixArena : public std::pmr::memory_resource {
+		public:
+			// the arena takes new buffers from the resource current until now
+			MatrixArena ();
+			MatrixArena (const MatrixArena&) = delete;
+			MatrixArena& operator= (const MatrixArena&) = delete;
+			~MatrixArena () override;
+
+			// gives every buffer kept for reuse back to the upstream resource
+			void release ();
+
+			// returns the bytes kept for reuse
+			std::size_t cached () const;
+
+		protected:
+			void* do_allocate (std::size_t t_bytes, std::size_t t_alignment) override;
+			void do_deallocate (void* t_pointer, std::size_t t_bytes, std::size_t t_alignment) override;
+			bool do_is_equal (const std::pmr::memory_resource& t_other) const noexcept override;
+
+		private:
+			std::pmr::memory_resource* m_upstream;
+			std::vector<std::vector<void*>> m_free {};		// buffers kept for reuse, by size class
+			std::size_t m_cached {0};
+			ResourceScope m_scope;							// last, so the arena is set up before it is current
+	};
+}
+
+#endif
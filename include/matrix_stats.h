@@ -0,0 +1,87 @@
+#ifndef MATRIX_STATS_CRYPT_10_10
+#define MATRIX_STATS_CRYPT_10_10
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#ifdef MATRIX_INSTRUMENT
+#include <chrono>
+#endif
+
+namespace m {
+
+	/* counters of what the library spends its time on, switched on by building it (and the code
+	  using it) with MATRIX_INSTRUMENT defined (make DEF=-DMATRIX_INSTRUMENT). Without it the hooks
+	  compile to nothing and snapshot() only reports the live matrix count.
+	  Times are wall clock and inclusive: an invert also counts in copy for the matrix it factors.
+	  Flops and bytes are nominal (2mnk for a product, cells read and written once, and so on). */
+	namespace stats {
+		enum operation_type {multiply, add, echelon, reduced_echelon, invert, determinant, transpose, copy, resize,
+				augment, scale, operation_count};
+
+		// calls are binned by duration: bucket k holds those taking [4^k, 4^(k + 1)) ns, the last one the rest
+		constexpr std::size_t histogram_buckets = 16;
+
+		struct operation_stats {
+			uint64_t calls, nanoseconds, flops, bytes;
+			uint64_t histogram[histogram_buckets];
+		};
+
+		struct snapshot_type {
+			operation_stats operations[operation_count];
+			uint64_t live_matrices;
+			uint64_t allocations, allocated_bytes;		// matrix buffers and product scratch space
+		};
+
+		// returns true if the library was built with MATRIX_INSTRUMENT
+		bool enabled ();
+
+		// returns the counters as they are now (they keep running while this reads them)
+		snapshot_type snapshot ();
+
+		// sets every counter back to zero (the live matrix count stays)
+		void reset ();
+
+		// returns the name of t_operation as used in json()
+		const char* name (operation_type t_operation);
+
+		// returns t_snapshot as a JSON object
+		std::string json (const snapshot_type& t_snapshot);
+	}
+
+	namespace detail {
+		void recordAllocation (std::size_t t_bytes);
+
+#ifdef MATRIX_INSTRUMENT
+		// adds the time from its construction to its destruction to an operation
+		class OperationTimer {
+			public:
+				OperationTimer (stats::operation_type t_operation, double t_flops, double t_bytes);
+				OperationTimer (const OperationTimer&) = delete;
+				OperationTimer& operator= (const OperationTimer&) = delete;
+				~OperationTimer ();
+			private:
+				stats::operation_type m_operation;
+				uint64_t m_flops, m_bytes;
+				std::chrono::steady_clock::time_point m_start;
+		};
+#endif
+	}
+}
+
+#ifdef MATRIX_INSTRUMENT
+// times the rest of the enclosing scope as one call of stats::t_operation
+#define M_INSTRUMENT(t_operation, t_flops, t_bytes) \
+	::m::detail::OperationTimer m_instrument_timer_(::m::stats::t_operation, double(t_flops), double(t_bytes))
+#define M_INSTRUMENT_ALLOCATION(t_bytes) ::m::detail::recordAllocation(t_bytes)
+// times the rest of the enclosing scope as evaluating t_cells cells of expression type E (see detail::expression_cost)
+#define M_INSTRUMENT_EXPRESSION(E, t_cells) \
+	::m::detail::OperationTimer m_instrument_timer_(::m::detail::expression_cost<E>::operation, \
+			::m::detail::expression_cost<E>::flops * double(t_cells), ::m::detail::expression_cost<E>::bytes * double(t_cells))
+#else
+#define M_INSTRUMENT(t_operation, t_flops, t_bytes) ((void)0)
+#define M_INSTRUMENT_ALLOCATION(t_bytes) ((void)0)
+#define M_INSTRUMENT_EXPRESSION(E, t_cells) ((void)0)
+#endif
+
+#endif
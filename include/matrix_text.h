@@ -0,0 +1,53 @@
+#ifndef MATRIX_TEXT_CRYPT_10_10
+#define MATRIX_TEXT_CRYPT_10_10
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include "matrix.h"
+
+namespace m {
+
+	/* bulk text import and export. Streams are read and written in large blocks, numbers are parsed with
+	  std::from_chars and formatted with std::to_chars, so nothing here depends on the locale. Writers put
+	  numbers in scientific notation with t_precision digits after the point (a negative t_precision picks the
+	  one set with Matrix::setPrecision); 8 digits are enough to read back exactly the same floats. */
+
+	/* reads delimited text (CSV and the like): one row per line, cells separated by any run of commas,
+	  semicolons, tabs or spaces. Blank lines and lines starting with '#' are skipped. Throws if a cell is not
+	  a number or rows differ in length. */
+	Matrix readDelimited (std::istream& t_stream);
+	Matrix readDelimited (const std::string& t_path);
+
+	// writes t_matrix as delimited text, one row per line with cells separated by t_delimiter
+	void writeDelimited (const ConstMatrixView& t_matrix, std::ostream& t_stream, char t_delimiter = ',', int t_precision = -1);
+	void writeDelimited (const ConstMatrixView& t_matrix, const std::string& t_path, char t_delimiter = ',', int t_precision = -1);
+
+	inline void writeDelimited (const Matrix& t_matrix, std::ostream& t_stream, char t_delimiter = ',', int t_precision = -1) {
+		writeDelimited(t_matrix.view(), t_stream, t_delimiter, t_precision);
+	}
+
+	inline void writeDelimited (const Matrix& t_matrix, const std::string& t_path, char t_delimiter = ',', int t_precision = -1) {
+		writeDelimited(t_matrix.view(), t_path, t_delimiter, t_precision);
+	}
+
+	/* reads a Matrix Market file: "array" (dense, column by column) or "coordinate" (listed cells, the rest
+	  zero, repeated cells summed) of real, integer or pattern values, general, symmetric or skew-symmetric.
+	  Throws on complex or hermitian files and on malformed ones. */
+	Matrix readMatrixMarket (std::istream& t_stream);
+	Matrix readMatrixMarket (const std::string& t_path);
+
+	// writes t_matrix as a general real Matrix Market "array" (dense, column by column, as the format wants)
+	void writeMatrixMarket (const ConstMatrixView& t_matrix, std::ostream& t_stream, int t_precision = -1);
+	void writeMatrixMarket (const ConstMatrixView& t_matrix, const std::string& t_path, int t_precision = -1);
+
+	inline void writeMatrixMarket (const Matrix& t_matrix, std::ostream& t_stream, int t_precision = -1) {
+		writeMatrixMarket(t_matrix.view(), t_stream, t_precision);
+	}
+
+	inline void writeMatrixMarket (const Matrix& t_matrix, const std::string& t_path, int t_precision = -1) {
+		writeMatrixMarket(t_matrix.view(), t_path, t_precision);
+	}
+}
+
+#endif
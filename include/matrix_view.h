@@ -0,0 +1,179 @@
+#ifndef MATRIX_VIEW_CRYPT_10_10
+#define MATRIX_VIEW_CRYPT_10_10
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "matrix_expression.h"
+
+namespace m {
+
+	class TransposedView;
+
+	/* read-only window over a block of cells owned by someone else (usually a Matrix, see Matrix::view):
+	  getRows() x getColumns() cells starting at data(), rows stride() cells apart. Taking one copies
+	  nothing. A view is only valid while the cells it looks at stay where they are, so it must not outlive
+	  its matrix nor be used after the matrix reallocates (resize, transpose of a non square matrix,
+	  assignment of other dimensions...). Views are expressions, so they mix freely with matrices in
+	  +, - and scaling, and are accepted by the matrix product and by the LU solvers. */
+	class ConstMatrixView : public MatrixExpression<ConstMatrixView> {
+		public:
+			using value_type		= float;
+			using length_type		= uint32_t;
+
+			// reads cells of one row (expression protocol)
+			struct row_reader {
+				const value_type* row;
+				value_type operator[] (length_type t_column) const { return row[t_column]; }
+			};
+
+			// views t_rows x t_columns cells starting at t_data, with rows t_stride cells apart
+			ConstMatrixView (const value_type* t_data, length_type t_rows, length_type t_columns, std::size_t t_stride)
+				: m_data(const_cast<value_type*>(t_data)), m_rows(t_rows), m_columns(t_columns), m_stride(t_stride) {}
+
+			// returns the number of rows
+			length_type getRows () const { return m_rows; }
+
+			// returns the number of columns
+			length_type getColumns () const { return m_columns; }
+
+			// returns pointer to the first cell; cell [i][j] is at data()[i * stride() + j]
+			const value_type* data () const { return m_data; }
+
+			// returns the number of cells between the starts of two consecutive rows
+			std::size_t stride () const { return m_stride; }
+
+			// returns value of cell at t_row and t_column indices (throws if out of bound)
+			value_type getCell (length_type t_row, length_type t_column) const;
+
+			// returns a view of the cells within rows t_i0 and t_i1, and columns t_j0 and t_j1 of this view
+			ConstMatrixView view (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) const;
+
+			// returns a view of row t_row
+			ConstMatrixView row (length_type t_row) const { return view(t_row, 0, t_row, m_columns - 1); }
+
+			// returns a view of column t_column
+			ConstMatrixView column (length_type t_column) const { return view(0, t_column, m_rows - 1, t_column); }
+
+			// returns the transpose of this view without moving any cell (see TransposedView)
+			TransposedView transposed () const;
+
+			// prints the cells in the same format as Matrix::print
+			void print () const;
+
+			// returns a reader over row t_row (expression protocol)
+			row_reader reader (length_type t_row) const { return {m_data + std::size_t(t_row) * m_stride}; }
+
+		protected:
+			value_type* m_data;		// only written through by MatrixView, which is handed mutable cells
+			length_type m_rows, m_columns;
+			std::size_t m_stride;
+
+			// checks that rows t_i0..t_i1 and columns t_j0..t_j1 lie in the view and returns the offset of the first cell
+			std::size_t m_offset (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) const;
+	};
+
+	/* window over a block of cells that writes through to them: setting cells of a view, filling it or
+	  assigning an expression to it changes the matrix it was taken from. Assigning to a view writes
+	  its cells and never rebinds it (use a new view for that). An expression assigned to a view may read
+	  the view itself, but not cells of the same matrix at other positions that the view overlaps. */
+	class MatrixView : public ConstMatrixView {
+		public:
+			// views t_rows x t_columns cells starting at t_data, with rows t_stride cells apart
+			MatrixView (value_type* t_data, length_type t_rows, length_type t_columns, std::size_t t_stride)
+				: ConstMatrixView(t_data, t_rows, t_columns, t_stride) {}
+
+			MatrixView (const MatrixView&) = default;
+
+			// returns pointer to the first cell
+			value_type* data () const { return m_data; }
+
+			// sets a cell at t_row and t_column indices to a t_value (throws if out of bound)
+			void setCell (length_type t_row, length_type t_column, value_type t_value);
+
+			// fills the view with a t_constant value
+			void fill (value_type t_constant);
+
+			// returns a view of the cells within rows t_i0 and t_i1, and columns t_j0 and t_j1 of this view
+			MatrixView view (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) const;
+
+			// returns a view of row t_row
+			MatrixView row (length_type t_row) const { return view(t_row, 0, t_row, m_columns - 1); }
+
+			// returns a view of column t_column
+			MatrixView column (length_type t_column) const { return view(0, t_column, m_rows - 1, t_column); }
+
+			// copies the cells of t_view into this view (throws if dimensions don't match)
+			MatrixView& operator= (const MatrixView& t_view);
+
+			// evaluates an element-wise expression into the cells of this view (throws if dimensions don't match)
+			template <class E>
+			MatrixView& operator= (const MatrixExpression<E>& t_expression);
+
+			// in-place element-wise updates of the viewed cells
+			template <class E>
+			MatrixView& operator+= (const MatrixExpression<E>& t_expression);
+			template <class E>
+			MatrixView& operator-= (const MatrixExpression<E>& t_expression);
+			MatrixView& operator*= (value_type t_constant);
+	};
+
+	/* transpose of the cells a ConstMatrixView looks at, taken in O(1): cell (i, j) is cell (j, i) of the
+	  view and nothing is moved. Products read it where it is, with its strides swapped, so A.transposed() * B
+	  never forms A^T. It is not an element-wise expression (reading it row by row would walk the cells
+	  column-wise); building a Matrix from it transposes the cells in one cache-friendly pass. The rules on
+	  validity are those of the view it is taken from. */
+	class TransposedView {
+		public:
+			using value_type		= ConstMatrixView::value_type;
+			using length_type		= ConstMatrixView::length_type;
+
+			explicit TransposedView (const ConstMatrixView& t_view) : m_view(t_view) {}
+
+			// returns the number of rows (the columns of the viewed cells)
+			length_type getRows () const { return m_view.getColumns(); }
+
+			// returns the number of columns (the rows of the viewed cells)
+			length_type getColumns () const { return m_view.getRows(); }
+
+			// returns value of cell at t_row and t_column indices (throws if out of bound)
+			value_type getCell (length_type t_row, length_type t_column) const { return m_view.getCell(t_column, t_row); }
+
+			// returns the view this is the transpose of
+			const ConstMatrixView& transposed () const { return m_view; }
+
+		private:
+			ConstMatrixView m_view;
+	};
+
+	inline TransposedView ConstMatrixView::transposed () const {
+		return TransposedView(*this);
+	}
+
+	namespace detail {
+		// prints the cells of t_view as Matrix::print does, with a '|' after every column listed in t_seperators
+		void printCells (const ConstMatrixView& t_view, const std::vector<uint32_t>& t_seperators);
+	}
+
+	template <class E>
+	MatrixView& MatrixView::operator= (const MatrixExpression<E>& t_expression) {
+		const E& expression = t_expression.self();
+		if (expression.getRows() != m_rows || expression.getColumns() != m_columns)
+			throw ("Dimensions of view and expression don't match!");
+		M_INSTRUMENT_EXPRESSION(E, double(m_rows) * m_columns);
+		detail::evaluate(m_data, m_stride, m_rows, m_columns, expression);
+		return *this;
+	}
+
+	template <class E>
+	MatrixView& MatrixView::operator+= (const MatrixExpression<E>& t_expression) {
+		return *this = *this + t_expression;
+	}
+
+	template <class E>
+	MatrixView& MatrixView::operator-= (const MatrixExpression<E>& t_expression) {
+		return *this = *this - t_expression;
+	}
+}
+
+#endif
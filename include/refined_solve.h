@@ -0,0 +1,33 @@
+#ifndef MATRIX_REFINED_SOLVE_CRYPT_10_10
+#define MATRIX_REFINED_SOLVE_CRYPT_10_10
+
+#include <vector>
+#include "matrix.h"
+
+namespace m {
+
+	/* mixed precision solve of A * x = b: A is factored once in float (LU, with the blocked kernels) and x
+	  is refined to double accuracy by x += A^-1 * (b - A * x), the residual computed in double and each
+	  correction solved with the float factors in O(n^2). A step gains about as many digits as float keeps
+	  beyond the condition number of A, so refining converges in a few steps while that number is well below
+	  1 / float epsilon (about 1e7). When it does not (a correction isn't at most half the one before it, or
+	  the float factors are singular) A is factored again in double and solved with that, at O(n^3) in double. */
+	struct RefinedSolution {
+		std::vector<double> x {};
+		unsigned iterations {0};		// refinement steps taken with the float factors (the first solve not counted)
+		bool converged {false};			// the backward error went down to the tolerance
+		bool fell_back {false};			// x comes from the double factorization
+		double backward_error {0};		// ||b - A * x|| / (||A|| * ||x||) in the infinity norm
+	};
+
+	/* solves the system of square matrix t_a, its float cells read exactly in double. Refining stops once the
+	  backward error is at most sqrt(n) double epsilons or after t_max_iterations steps, falling back
+	  to double then (throws if sizes don't match, or if A is singular in double too) */
+	RefinedSolution refinedSolve (const Matrix& t_a, const std::vector<double>& t_b, unsigned t_max_iterations = 30);
+
+	// the same for a t_n x t_n double matrix t_a given row by row, factored in float rounded from it
+	RefinedSolution refinedSolve (const std::vector<double>& t_a, Matrix::length_type t_n, const std::vector<double>& t_b,
+			unsigned t_max_iterations = 30);
+}
+
+#endif
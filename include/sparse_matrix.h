@@ -0,0 +1,91 @@
+#ifndef MATRIX_SPARSE_CRYPT_10_10
+#define MATRIX_SPARSE_CRYPT_10_10
+
+#include <vector>
+#include <cstddef>
+#include "matrix.h"
+
+namespace m {
+
+	/* matrix that only stores its non zero cells, in compressed sparse rows (csr) or columns (csc).
+	  For csr, the cells of row i are values()[offsets()[i] .. offsets()[i + 1]) with their columns in
+	  indices() (ascending); csc is the same with rows and columns swapped. Products cost O(non zeros)
+	  instead of O(rows * columns) and are split across threads (see Matrix::setThreads). Products are
+	  fastest from csr, which also is what the triplet and dense constructors build by default. */
+	class SparseMatrix {
+		public:
+			using value_type		= Matrix::value_type;
+			using length_type		= Matrix::length_type;
+			enum format_type {csr, csc};
+
+			// one cell of a matrix given by its coordinates
+			struct triplet {
+				length_type row, column;
+				value_type value;
+			};
+
+			// creates a t_rows x t_columns matrix of zeros
+			SparseMatrix (length_type t_rows, length_type t_columns, format_type t_format = csr);
+
+			/* creates a t_rows x t_columns matrix from its cells t_triplets, given in any order (cells given
+			  more than once are summed, throws if a cell is out of bound) */
+			SparseMatrix (length_type t_rows, length_type t_columns, const std::vector<triplet>& t_triplets,
+					format_type t_format = csr);
+
+			// creates a sparse copy of t_matrix, dropping cells whose absolute value is t_tolerance or less
+			explicit SparseMatrix (const Matrix& t_matrix, value_type t_tolerance = 0, format_type t_format = csr);
+			explicit SparseMatrix (const ConstMatrixView& t_matrix, value_type t_tolerance = 0, format_type t_format = csr);
+
+			// returns the number of rows
+			length_type getRows () const;
+
+			// returns the number of columns
+			length_type getColumns () const;
+
+			// returns the number of stored cells
+			std::size_t getNonZeros () const;
+
+			// returns the storage format
+			format_type getFormat () const;
+
+			// returns value of cell at t_row and t_column indices (zero if not stored, throws if out of bound)
+			value_type getCell (length_type t_row, length_type t_column) const;
+
+			// rebuilds the storage in t_format (O(non zeros) when it changes) and returns the matrix
+			SparseMatrix& convert (format_type t_format);
+
+			// sets the matrix to its transpose in O(1), by reading its csr storage as csc (or back), and returns it
+			SparseMatrix& transpose ();
+
+			// returns the dense matrix holding the same cells
+			Matrix toDense () const;
+
+			// computes t_y = this * t_x (throws if the size of t_x doesn't match the columns); t_y is resized
+			void multiply (const std::vector<value_type>& t_x, std::vector<value_type>& t_y) const;
+
+			// returns this * t_x
+			std::vector<value_type> operator* (const std::vector<value_type>& t_x) const;
+
+			// returns this * t_matrix as a dense matrix (throws if columns of first != rows of second)
+			Matrix operator* (const Matrix& t_matrix) const;
+			Matrix operator* (const ConstMatrixView& t_matrix) const;
+
+			// storage arrays (see above)
+			const std::vector<std::size_t>& offsets () const;
+			const std::vector<length_type>& indices () const;
+			const std::vector<value_type>& values () const;
+
+		private:
+			length_type m_rows, m_columns;
+			format_type m_format;
+			std::vector<std::size_t> m_offsets;		// one more than rows (csr) or columns (csc)
+			std::vector<length_type> m_indices {};
+			std::vector<value_type> m_values {};
+
+			length_type m_major () const { return m_format == csr ? m_rows : m_columns; }
+			length_type m_minor () const { return m_format == csr ? m_columns : m_rows; }
+			void m_fromView (const ConstMatrixView& t_matrix, value_type t_tolerance);
+	};
+}
+
+#endif
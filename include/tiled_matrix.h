@@ -0,0 +1,119 @@
+#ifndef MATRIX_TILED_CRYPT_10_10
+#define MATRIX_TILED_CRYPT_10_10
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "matrix.h"
+
+namespace m {
+
+	namespace detail {
+		class TileStore;
+	}
+
+	/* out-of-core matrix kept in a file as square tiles of tileSize() rows and columns (smaller ones at the
+	  right and bottom edges), for matrices larger than memory. Tiles are read when first needed and kept in
+	  a cache of a bounded number of bytes (the budget); once it is full the least recently used tile makes
+	  room, written back first if it was changed. Operations go over the tiles in order and have the next
+	  ones read on the thread pool while they compute, so reading and computing overlap.
+
+	  Tiles come out as ordinary matrices (tile(), read()) that every Matrix operation takes. Handing one
+	  out is O(1), as the copy holds the cached cells (see Matrix), and it stays valid after the cache lets
+	  go of the tile. Const member functions may be called from many threads at once. */
+	class TiledMatrix {
+		public:
+			using value_type		= Matrix::value_type;
+			using length_type		= Matrix::length_type;
+
+			static constexpr length_type default_tile = 1024;					// 4 MB tiles
+			static constexpr std::size_t default_budget = std::size_t(1) << 30;	// 1 GB of tiles
+
+			/* creates a zero t_rows x t_columns matrix in a new file at t_path, replacing what is there
+			  (throws if the file can't be made, or if a length is zero) */
+			TiledMatrix (const std::string& t_path, length_type t_rows, length_type t_columns,
+					length_type t_tile = default_tile, std::size_t t_budget = default_budget);
+
+			// opens the tiled matrix file at t_path (throws if it can't be opened or isn't a tiled matrix file)
+			static TiledMatrix open (const std::string& t_path, std::size_t t_budget = default_budget);
+
+			// writes t_matrix to a new tiled matrix file at t_path and returns it
+			static TiledMatrix store (const Matrix& t_matrix, const std::string& t_path,
+					length_type t_tile = default_tile, std::size_t t_budget = default_budget);
+
+			TiledMatrix (TiledMatrix&& t_matrix) noexcept;
+			TiledMatrix& operator= (TiledMatrix&& t_matrix) noexcept;
+			TiledMatrix (const TiledMatrix&) = delete;
+			TiledMatrix& operator= (const TiledMatrix&) = delete;
+
+			// writes back the changed tiles still cached (errors are lost; call flush() to see them)
+			~TiledMatrix ();
+
+			length_type getRows () const;
+			length_type getColumns () const;
+
+			// returns the number of rows (and columns) of a full tile
+			length_type tileSize () const;
+
+			// returns the number of tiles down the matrix, and across it
+			length_type tileRows () const;
+			length_type tileColumns () const;
+
+			// returns the bytes of tiles the cache keeps at most (more while the tiles in use take more)
+			std::size_t getBudget () const;
+			void setBudget (std::size_t t_budget);
+
+			// returns tile (t_i, t_j) in O(1) once cached (throws if out of bound)
+			Matrix tile (length_type t_i, length_type t_j) const;
+
+			// replaces tile (t_i, t_j) with t_tile, written back when the cache lets go of it (throws if dimensions don't match)
+			void setTile (length_type t_i, length_type t_j, const Matrix& t_tile);
+
+			// starts reading tile (t_i, t_j) on the thread pool, unless it is cached or being read already
+			void prefetch (length_type t_i, length_type t_j) const;
+
+			// copies the cells within rows t_i0 and t_i1, and columns t_j0 and t_j1, into a matrix (throws if out of bound)
+			Matrix read (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) const;
+
+			// copies t_matrix over the cells starting at row t_i0 and column t_j0 (throws if it doesn't fit)
+			void write (length_type t_i0, length_type t_j0, const Matrix& t_matrix);
+
+			value_type getCell (length_type t_row, length_type t_column) const;
+			void setCell (length_type t_row, length_type t_column, value_type t_value);
+
+			// writes the changed tiles back to the file (throws on failure)
+			void flush () const;
+
+			// adds t_matrix to this one tile by tile (throws if dimensions or tile sizes don't match)
+			TiledMatrix& add (const TiledMatrix& t_matrix);
+
+			/* writes the transpose to a new file at t_path and returns it, each tile transposed on its way
+			  (throws if t_path is the file of this matrix) */
+			TiledMatrix transposed (const std::string& t_path) const;
+
+			/* factors the square matrix in place into L and U packed as LU::factors() does, with partial pivoting,
+			  and returns the row swaps as LU::pivots() does; U is an echelon form of the matrix, and a zero on its
+			  diagonal means the matrix is singular. Tile columns are done one after the other: the current one
+			  is factored in memory, then every later one is read, brought up to date with a triangular solve
+			  and a GEMM, and written back. A few tile columns of cells must fit in the budget (throws if not square) */
+			std::vector<length_type> factorize ();
+
+			// solves A * x = t_b with the factors and row swaps left by factorize() (throws if sizes don't match)
+			std::vector<value_type> solveFactored (const std::vector<length_type>& t_pivots, const std::vector<value_type>& t_b) const;
+
+		private:
+			std::shared_ptr<detail::TileStore> m_store;		// shared with reads still running on the pool
+
+			explicit TiledMatrix (std::shared_ptr<detail::TileStore> t_store);
+
+			friend TiledMatrix multiply (const TiledMatrix& t_left, const TiledMatrix& t_right, const std::string& t_path);
+	};
+
+	/* t_left * t_right written to a new file at t_path: every tile of the product sums the products of a row
+	  of tiles of t_left and a column of tiles of t_right, through GEMM, while the next pair is read
+	  (throws if columns of first != rows of second, if tile sizes don't match, or if t_path is the file of either) */
+	TiledMatrix multiply (const TiledMatrix& t_left, const TiledMatrix& t_right, const std::string& t_path);
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef MATRIX_UPDATABLE_INVERSE_CRYPT_10_10
+#define MATRIX_UPDATABLE_INVERSE_CRYPT_10_10
+
+#include <vector>
+#include "matrix.h"
+
+namespace m {
+
+	/* square matrix A kept together with its inverse and determinant while it takes rank-1 changes
+	  (A += u * v^T, which covers setting a cell and adding to a row or a column). Every change updates the
+	  inverse in O(n^2) by the Sherman-Morrison formula and the determinant by the matrix determinant lemma,
+	  where factoring again would be O(n^3). Rounding piles up over many updates, so every few of them one
+	  column of A * A^-1 - I is checked in O(n^2); once its largest cell drifts past the threshold (above
+	  what rounding leaves right after factoring) the inverse is computed afresh from A. */
+	class UpdatableInverse {
+		public:
+			using value_type		= Matrix::value_type;
+			using length_type		= Matrix::length_type;
+
+			// keeps square matrix t_matrix and its inverse (throws if not square or singular)
+			explicit UpdatableInverse (const Matrix& t_matrix, value_type t_drift_threshold = value_type(1e-3));
+
+			// returns the number of rows (and columns) of the matrix
+			length_type size () const;
+
+			// returns the matrix with every change applied
+			const Matrix& matrix () const;
+
+			// returns the inverse of the matrix (throws if singular)
+			const Matrix& inverse () const;
+
+			// returns the determinant of the matrix
+			value_type determinant () const;
+
+			/* returns true if a change made the matrix singular. It stays usable: further changes refactor
+			  it in O(n^3) each, until one makes it invertible again */
+			bool isSingular () const;
+
+			// adds t_u * t_v^T to the matrix (throws if sizes don't match)
+			void update (const std::vector<value_type>& t_u, const std::vector<value_type>& t_v);
+
+			// sets the cell at t_row and t_column indices to t_value (throws if out of bound)
+			void setCell (length_type t_row, length_type t_column, value_type t_value);
+
+			// adds t_delta to row t_row (throws if out of bound or size doesn't match)
+			void addToRow (length_type t_row, const std::vector<value_type>& t_delta);
+
+			// adds t_delta to column t_column (throws if out of bound or size doesn't match)
+			void addToColumn (length_type t_column, const std::vector<value_type>& t_delta);
+
+			/* adds t_multiple times row t_source to row t_target, as Matrix::rowOperation(add_multiple) does;
+			  the determinant stays and the inverse only has one column changed, in O(n) */
+			void addRowMultiple (length_type t_source, length_type t_target, value_type t_multiple);
+
+			// solves A * x = t_b and returns x in O(n^2) (throws if singular or size doesn't match)
+			std::vector<value_type> solve (const std::vector<value_type>& t_b) const;
+
+			// computes the inverse and determinant afresh from the matrix, in O(n^3)
+			void refactor ();
+
+			// returns the drift allowed before the inverse is computed afresh
+			value_type getDriftThreshold () const;
+
+			// sets the drift allowed before the inverse is computed afresh
+			void setDriftThreshold (value_type t_drift_threshold);
+
+			// returns the drift last measured: largest cell of the checked column of A * A^-1 - I
+			value_type drift () const;
+
+			// returns the number of changes since the inverse was last computed afresh
+			std::size_t updates () const;
+
+			// returns the number of times the inverse was computed afresh, the first one included
+			std::size_t refactors () const;
+
+		private:
+			Matrix m_matrix;
+			Matrix m_inverse;
+			value_type m_determinant {0};
+			value_type m_threshold;
+			value_type m_drift {0};
+			value_type m_baseline {0};		// drift measured right after factoring, which is rounding alone
+			std::size_t m_updates {0};
+			std::size_t m_refactors {0};
+			length_type m_checked {0};		// column of the inverse checked next
+			bool m_singular {false};
+
+			// returns t_vector^T * A^-1
+			std::vector<value_type> m_leftProduct (const std::vector<value_type>& t_vector) const;
+			// returns A^-1 * t_vector
+			std::vector<value_type> m_rightProduct (const std::vector<value_type>& t_vector) const;
+			// returns column t_column of A^-1
+			std::vector<value_type> m_inverseColumn (length_type t_column) const;
+			/* A^-1 -= t_w * t_z^T / (1 + t_vw), for t_w = A^-1 * u, t_z = v^T * A^-1 and t_vw = v^T * A^-1 * u
+			  worked out before u * v^T was added to the matrix */
+			void m_apply (const std::vector<value_type>& t_w, const std::vector<value_type>& t_z, value_type t_vw);
+			// counts a change, measures the drift when it is due and refactors if it went too far
+			void m_changed ();
+			// returns the largest cell of column t_column of A * A^-1 - I
+			value_type m_residual (length_type t_column) const;
+	};
+}
+
+#endif
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <new>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define M_GEMM_X86
+#endif
+#include <vector>
+#include "gemm.h"
+#include "thread_pool.h"
+
+using namespace m;
+using namespace m::detail;
+
+namespace {
+
+	// cache blocking: an MC x KC panel of A stays in L2, a KC x NR sliver of B in L1
+	constexpr length_type MC = 120, KC = 256, NC = 3072;
+
+	// products with at most this many multiply-adds skip packing entirely
+	constexpr std::size_t SMALL_PRODUCT = 32 * 32 * 32;
+
+	// products with fewer multiply-adds than this stay on the calling thread
+	constexpr std::size_t PARALLEL_PRODUCT = 128 * 128 * 128;
+
+	using kernel_function = void (*)(length_type t_kc, const value_type* t_a, const value_type* t_b,
+			value_type* t_c, std::size_t t_ldc, value_type t_alpha, value_type t_beta, length_type t_m, length_type t_n);
+
+	struct Kernel {
+		length_type mr, nr;		// rows of the A sliver and columns of the B sliver one call consumes
+		kernel_function run;
+		const char* name;
+	};
+
+	// packing buffer borrowed from a per-thread free list and handed back on destruction, so a thread
+	// that picks up another product while waiting on its own never shares a buffer with it
+	class PackBuffer {
+		public:
+			explicit PackBuffer (std::size_t t_count) {
+				std::vector<Block>& free_blocks = freeList().blocks;
+				if (!free_blocks.empty()) {
+					m_block = free_blocks.back();
+					free_blocks.pop_back();
+				}
+				if (m_block.capacity < t_count) {
+					release(m_block);
+					M_INSTRUMENT_ALLOCATION(t_count * sizeof(value_type));
+					m_block.data = static_cast<value_type*>(::operator new(t_count * sizeof(value_type), std::align_val_t(Matrix::alignment)));
+					m_block.capacity = t_count;
+				}
+			}
+			PackBuffer (const PackBuffer&) = delete;
+			PackBuffer& operator= (const PackBuffer&) = delete;
+			~PackBuffer () { freeList().blocks.push_back(m_block); }
+
+			value_type* data () const { return m_block.data; }
+		private:
+			struct Block {
+				value_type* data {nullptr};
+				std::size_t capacity {0};
+			};
+			struct FreeList {
+				std::vector<Block> blocks {};
+				~FreeList () { for (Block& block : blocks) release(block); }
+			};
+
+			Block m_block {};
+
+			static FreeList& freeList () {
+				thread_local FreeList list;
+				return list;
+			}
+			static void release (Block& t_block) {
+				if (t_block.data) ::operator delete(t_block.data, std::align_val_t(Matrix::alignment));
+				t_block = Block {};
+			}
+	};
+
+	// writes an mr x nr accumulator tile (row-major, leading dimension t_nr) into the t_m x t_n corner of C
+	inline void storeTile (const value_type* t_acc, length_type t_nr, value_type* t_c, std::size_t t_ldc,
+			value_type t_alpha, value_type t_beta, length_type t_m, length_type t_n) {
+		for (length_type i = 0; i < t_m; i++) {
+			value_type* c = t_c + i * t_ldc;
+			const value_type* acc = t_acc + i * t_nr;
+			if (t_beta == value_type(0))
+				for (length_type j = 0; j < t_n; j++) c[j] = t_alpha * acc[j];
+			else
+				for (length_type j = 0; j < t_n; j++) c[j] = t_alpha * acc[j] + t_beta * c[j];
+		}
+	}
+
+#ifndef M_GEMM_X86
+	void scalarKernel (length_type t_kc, const value_type* t_a, const value_type* t_b,
+			value_type* t_c, std::size_t t_ldc, value_type t_alpha, value_type t_beta, length_type t_m, length_type t_n) {
+		value_type acc[4 * 4] = {};
+		for (length_type p = 0; p < t_kc; p++, t_a += 4, t_b += 4)
+			for (length_type i = 0; i < 4; i++)
+				for (length_type j = 0; j < 4; j++)
+					acc[i * 4 + j] += t_a[i] * t_b[j];
+		storeTile(acc, 4, t_c, t_ldc, t_alpha, t_beta, t_m, t_n);
+	}
+#else
+	void sseKernel (length_type t_kc, const value_type* t_a, const value_type* t_b,
+			value_type* t_c, std::size_t t_ldc, value_type t_alpha, value_type t_beta, length_type t_m, length_type t_n) {
+		__m128 c[4][2];
+		for (length_type i = 0; i < 4; i++) c[i][0] = c[i][1] = _mm_setzero_ps();
+		for (length_type p = 0; p < t_kc; p++, t_a += 4, t_b += 8) {
+			__m128 b0 = _mm_load_ps(t_b), b1 = _mm_load_ps(t_b + 4);
+			for (length_type i = 0; i < 4; i++) {
+				__m128 a = _mm_set1_ps(t_a[i]);
+				c[i][0] = _mm_add_ps(c[i][0], _mm_mul_ps(a, b0));
+				c[i][1] = _mm_add_ps(c[i][1], _mm_mul_ps(a, b1));
+			}
+		}
+		alignas(16) value_type acc[4 * 8];
+		for (length_type i = 0; i < 4; i++) {
+			_mm_store_ps(acc + i * 8, c[i][0]);
+			_mm_store_ps(acc + i * 8 + 4, c[i][1]);
+		}
+		storeTile(acc, 8, t_c, t_ldc, t_alpha, t_beta, t_m, t_n);
+	}
+
+	__attribute__((target("avx2,fma")))
+	void avx2Kernel (length_type t_kc, const value_type* t_a, const value_type* t_b,
+			value_type* t_c, std::size_t t_ldc, value_type t_alpha, value_type t_beta, length_type t_m, length_type t_n) {
+		__m256 c[6][2];
+		for (length_type i = 0; i < 6; i++) c[i][0] = c[i][1] = _mm256_setzero_ps();
+		for (length_type p = 0; p < t_kc; p++, t_a += 6, t_b += 16) {
+			__m256 b0 = _mm256_load_ps(t_b), b1 = _mm256_load_ps(t_b + 8);
+			for (length_type i = 0; i < 6; i++) {
+				__m256 a = _mm256_broadcast_ss(t_a + i);
+				c[i][0] = _mm256_fmadd_ps(a, b0, c[i][0]);
+				c[i][1] = _mm256_fmadd_ps(a, b1, c[i][1]);
+			}
+		}
+		if (t_m == 6 && t_n == 16) {	// full tile goes straight to C
+			__m256 alpha = _mm256_set1_ps(t_alpha), beta = _mm256_set1_ps(t_beta);
+			for (length_type i = 0; i < 6; i++) {
+				value_type* c_row = t_c + i * t_ldc;
+				__m256 r0 = _mm256_mul_ps(alpha, c[i][0]), r1 = _mm256_mul_ps(alpha, c[i][1]);
+				if (t_beta != value_type(0)) {
+					r0 = _mm256_fmadd_ps(beta, _mm256_loadu_ps(c_row), r0);
+					r1 = _mm256_fmadd_ps(beta, _mm256_loadu_ps(c_row + 8), r1);
+				}
+				_mm256_storeu_ps(c_row, r0);
+				_mm256_storeu_ps(c_row + 8, r1);
+			}
+			return;
+		}
+		alignas(32) value_type acc[6 * 16];
+		for (length_type i = 0; i < 6; i++) {
+			_mm256_store_ps(acc + i * 16, c[i][0]);
+			_mm256_store_ps(acc + i * 16 + 8, c[i][1]);
+		}
+		storeTile(acc, 16, t_c, t_ldc, t_alpha, t_beta, t_m, t_n);
+	}
+#endif
+
+	const Kernel& kernel () {
+		static const Kernel picked = [] {
+#ifdef M_GEMM_X86
+			if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+				return Kernel {6, 16, avx2Kernel, "avx2"};
+			return Kernel {4, 8, sseKernel, "sse"};
+#else
+			return Kernel {4, 4, scalarKernel, "scalar"};
+#endif
+		}();
+		return picked;
+	}
+
+	// copies a t_mc x t_kc block of A into slivers of t_mr rows, each stored column by column (zero padded)
+	void packA (length_type t_mc, length_type t_kc, const value_type* t_a, std::size_t t_rs, std::size_t t_cs,
+			length_type t_mr, value_type* t_packed) {
+		for (length_type i0 = 0; i0 < t_mc; i0 += t_mr) {
+			length_type rows = std::min(t_mr, t_mc - i0);
+			for (length_type p = 0; p < t_kc; p++, t_packed += t_mr) {
+				const value_type* a = t_a + i0 * t_rs + p * t_cs;
+				length_type i = 0;
+				for (; i < rows; i++) t_packed[i] = a[i * t_rs];
+				for (; i < t_mr; i++) t_packed[i] = value_type(0);
+			}
+		}
+	}
+
+	// copies a t_kc x t_nc block of B into slivers of t_nr columns, each stored row by row (zero padded)
+	void packB (length_type t_kc, length_type t_nc, const value_type* t_b, std::size_t t_rs, std::size_t t_cs,
+			length_type t_nr, value_type* t_packed) {
+		for (length_type j0 = 0; j0 < t_nc; j0 += t_nr) {
+			length_type columns = std::min(t_nr, t_nc - j0);
+			for (length_type p = 0; p < t_kc; p++, t_packed += t_nr) {
+				const value_type* b = t_b + p * t_rs + j0 * t_cs;
+				length_type j = 0;
+				for (; j < columns; j++) t_packed[j] = b[j * t_cs];
+				for (; j < t_nr; j++) t_packed[j] = value_type(0);
+			}
+		}
+	}
+
+	void scaleC (length_type t_m, length_type t_n, value_type t_beta, value_type* t_c, std::size_t t_ldc) {
+		for (length_type i = 0; i < t_m; i++)
+			for (length_type j = 0; j < t_n; j++)
+				t_c[i * t_ldc + j] = t_beta == value_type(0) ? value_type(0) : t_beta * t_c[i * t_ldc + j];
+	}
+}
+
+void m::detail::gemm (length_type t_m, length_type t_n, length_type t_k, value_type t_alpha,
+		const value_type* t_a, std::size_t t_a_row_stride, std::size_t t_a_column_stride,
+		const value_type* t_b, std::size_t t_b_row_stride, std::size_t t_b_column_stride,
+		value_type t_beta, value_type* t_c, std::size_t t_ldc) {
+	if (t_m == 0 || t_n == 0) return;
+	if (t_k == 0 || t_alpha == value_type(0)) { scaleC(t_m, t_n, t_beta, t_c, t_ldc); return; }
+
+	if (std::size_t(t_m) * t_n * t_k <= SMALL_PRODUCT) {	// plain dot products, same summation order as textbook i-j-k
+		for (length_type i = 0; i < t_m; i++)
+			for (length_type j = 0; j < t_n; j++) {
+				value_type sum = 0;
+				for (length_type p = 0; p < t_k; p++)
+					sum += t_a[i * t_a_row_stride + p * t_a_column_stride] * t_b[p * t_b_row_stride + j * t_b_column_stride];
+				value_type& c = t_c[i * t_ldc + j];
+				c = t_beta == value_type(0) ? t_alpha * sum : t_alpha * sum + t_beta * c;
+			}
+		return;
+	}
+
+	const Kernel& k = kernel();
+	ThreadPool& pool = ThreadPool::instance();
+	bool parallel = pool.size() > 1 && std::size_t(t_m) * t_n * t_k >= PARALLEL_PRODUCT;
+
+	// when running in parallel, rows of C are cut finer so every thread gets a couple of blocks
+	length_type mc_step = MC;
+	if (parallel) {
+		length_type rows_per_block = (t_m + 2 * pool.size() - 1) / (2 * pool.size());
+		mc_step = std::min(MC, std::max(k.mr, (rows_per_block + k.mr - 1) / k.mr * k.mr));
+	}
+	length_type nc_max = std::min(NC, (t_n + k.nr - 1) / k.nr * k.nr);
+	length_type kc_max = std::min(KC, t_k);
+	PackBuffer packed_b(std::size_t(nc_max) * kc_max);
+
+	for (length_type jc = 0; jc < t_n; jc += NC) {
+		length_type nc = std::min(NC, t_n - jc);
+		length_type slivers = (nc + k.nr - 1) / k.nr;
+		for (length_type pc = 0; pc < t_k; pc += KC) {
+			length_type kc = std::min(KC, t_k - pc);
+			value_type beta = pc == 0 ? t_beta : value_type(1);	// later K panels accumulate onto the first
+			const value_type* b = t_b + pc * t_b_row_stride + jc * t_b_column_stride;
+
+			auto pack_slivers = [&] (std::size_t t_first, std::size_t t_last) {
+				length_type j0 = length_type(t_first) * k.nr, j1 = std::min(nc, length_type(t_last) * k.nr);
+				packB(kc, j1 - j0, b + j0 * t_b_column_stride, t_b_row_stride, t_b_column_stride, k.nr, packed_b.data() + std::size_t(j0) * kc);
+			};
+			auto run_blocks = [&] (std::size_t t_first, std::size_t t_last) {
+				PackBuffer packed_a(std::size_t(mc_step) * kc_max);
+				for (std::size_t block = t_first; block < t_last; block++) {
+					length_type ic = length_type(block) * mc_step, mc = std::min(mc_step, t_m - ic);
+					packA(mc, kc, t_a + ic * t_a_row_stride + pc * t_a_column_stride, t_a_row_stride, t_a_column_stride, k.mr, packed_a.data());
+					for (length_type jr = 0; jr < nc; jr += k.nr)
+						for (length_type ir = 0; ir < mc; ir += k.mr)
+							k.run(kc, packed_a.data() + std::size_t(ir) * kc, packed_b.data() + std::size_t(jr) * kc,
+									t_c + (ic + ir) * t_ldc + jc + jr, t_ldc, t_alpha, beta,
+									std::min(k.mr, mc - ir), std::min(k.nr, nc - jr));
+				}
+			};
+
+			length_type blocks = (t_m + mc_step - 1) / mc_step;
+			if (parallel) {
+				pool.parallelFor(0, slivers, 4, pack_slivers);
+				pool.parallelFor(0, blocks, 1, run_blocks);
+			} else {
+				pack_slivers(0, slivers);
+				run_blocks(0, blocks);
+			}
+		}
+	}
+}
+
+void m::detail::gemm (length_type t_m, length_type t_n, length_type t_k, value_type t_alpha,
+		const value_type* t_a, std::size_t t_lda, const value_type* t_b, std::size_t t_ldb,
+		value_type t_beta, value_type* t_c, std::size_t t_ldc) {
+	gemm(t_m, t_n, t_k, t_alpha, t_a, t_lda, 1, t_b, t_ldb, 1, t_beta, t_c, t_ldc);
+}
+
+const char* m::detail::gemmKernelName () {
+	return kernel().name;
+}
@@ -0,0 +1,32 @@
+#ifndef MATRIX_GEMM_CRYPT_10_10
+#define MATRIX_GEMM_CRYPT_10_10
+
+#include <cstddef>
+#include "matrix.h"
+
+namespace m {
+	namespace detail {
+
+		using value_type	= Matrix::value_type;
+		using length_type	= Matrix::length_type;
+
+		/* general matrix product C = t_alpha * A * B + t_beta * C, where A is t_m x t_k and B is t_k x t_n.
+		  Cell (i, k) of A is read from t_a[i * t_a_row_stride + k * t_a_column_stride] (same for B), so a
+		  transposed operand is passed by swapping its strides. C is row-major with leading dimension t_ldc.
+		  When t_beta is zero, C is not read before it is written. */
+		void gemm (length_type t_m, length_type t_n, length_type t_k, value_type t_alpha,
+				const value_type* t_a, std::size_t t_a_row_stride, std::size_t t_a_column_stride,
+				const value_type* t_b, std::size_t t_b_row_stride, std::size_t t_b_column_stride,
+				value_type t_beta, value_type* t_c, std::size_t t_ldc);
+
+		// row-major shorthand of the above with leading dimensions t_lda, t_ldb and t_ldc
+		void gemm (length_type t_m, length_type t_n, length_type t_k, value_type t_alpha,
+				const value_type* t_a, std::size_t t_lda, const value_type* t_b, std::size_t t_ldb,
+				value_type t_beta, value_type* t_c, std::size_t t_ldc);
+
+		// returns the name of the micro-kernel picked for this machine ("avx2", "sse" or "scalar")
+		const char* gemmKernelName ();
+	}
+}
+
+#endif
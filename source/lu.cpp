@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cmath>
+#include "lu.h"
+#include "gemm.h"
+#include "thread_pool.h"
+
+using namespace m;
+
+namespace {
+	constexpr LU::length_type BLOCK = 64;					// columns factored per panel
+	constexpr std::size_t PARALLEL_CELLS = 1 << 15;		// smaller updates stay on the calling thread
+
+	// calls t_body(first, last) over [0, t_count) split across the pool when t_work cells are touched
+	template <class Body>
+	void split (std::size_t t_count, std::size_t t_work, Body&& t_body) {
+		detail::ThreadPool& pool = detail::ThreadPool::instance();
+		if (pool.size() <= 1 || t_work < PARALLEL_CELLS || t_count < 2) { t_body(std::size_t(0), t_count); return; }
+		std::size_t grain = std::max<std::size_t>(1, t_count / (std::size_t(pool.size()) * 4));
+		pool.parallelFor(0, t_count, grain, t_body);
+	}
+
+	using value_type = LU::value_type;
+	using length_type = LU::length_type;
+
+	constexpr length_type SOLVE_BLOCK = 64;		// rows substituted per block of a triangular solve, the rest is GEMM
+
+	// substitution through the t_n x t_n triangle at t_t, blocks of columns of t_b going to different threads
+	void substitute (const value_type* t_t, std::size_t t_ldt, length_type t_n, value_type* t_b, std::size_t t_ldb,
+			length_type t_columns, bool t_lower, bool t_unit) {
+		split(t_columns, std::size_t(t_n) * t_n * t_columns, [&] (std::size_t t_first, std::size_t t_last) {
+			for (length_type step = 0; step < t_n; step++) {
+				length_type i = t_lower ? step : t_n - 1 - step;
+				value_type* row = t_b + i * t_ldb;
+				length_type k0 = t_lower ? 0 : i + 1, k1 = t_lower ? i : t_n;
+				for (length_type k = k0; k < k1; k++) {
+					value_type multiple = t_t[i * t_ldt + k];
+					if (multiple == value_type(0)) continue;
+					const value_type* source = t_b + k * t_ldb;
+					for (std::size_t c = t_first; c < t_last; c++)
+						row[c] -= multiple * source[c];
+				}
+				if (t_unit) continue;
+				value_type diagonal = t_t[i * t_ldt + i];
+				for (std::size_t c = t_first; c < t_last; c++)
+					row[c] /= diagonal;
+			}
+		});
+	}
+
+	// T * X = B with T lower triangular: a block of rows is substituted, then B below it loses its share with one GEMM
+	void lowerSolve (const value_type* t_t, std::size_t t_ldt, length_type t_n, value_type* t_b, std::size_t t_ldb,
+			length_type t_columns, bool t_unit) {
+		for (length_type k0 = 0; k0 < t_n; k0 += SOLVE_BLOCK) {
+			length_type k1 = std::min(t_n, k0 + SOLVE_BLOCK);
+			substitute(t_t + k0 * t_ldt + k0, t_ldt, k1 - k0, t_b + k0 * t_ldb, t_ldb, t_columns, true, t_unit);
+			if (k1 < t_n)
+				detail::gemm(t_n - k1, t_columns, k1 - k0, value_type(-1), t_t + k1 * t_ldt + k0, t_ldt,
+						t_b + k0 * t_ldb, t_ldb, value_type(1), t_b + k1 * t_ldb, t_ldb);
+		}
+	}
+
+	// T * X = B with T upper triangular, the same from the last block of rows up
+	void upperSolve (const value_type* t_t, std::size_t t_ldt, length_type t_n, value_type* t_b, std::size_t t_ldb,
+			length_type t_columns, bool t_unit) {
+		for (length_type k1 = t_n; k1 > 0; ) {
+			length_type k0 = (k1 - 1) / SOLVE_BLOCK * SOLVE_BLOCK;
+			substitute(t_t + k0 * t_ldt + k0, t_ldt, k1 - k0, t_b + k0 * t_ldb, t_ldb, t_columns, false, t_unit);
+			if (k0 > 0)
+				detail::gemm(k0, t_columns, k1 - k0, value_type(-1), t_t + k0, t_ldt,
+						t_b + k0 * t_ldb, t_ldb, value_type(1), t_b, t_ldb);
+			k1 = k0;
+		}
+	}
+
+	// checks what solveLower and solveUpper are given
+	void checkTriangular (const ConstMatrixView& t_t, const MatrixView& t_b, bool t_unit) {
+		if (t_t.getRows() != t_t.getColumns()) throw ("Triangular matrix must be square!");
+		if (t_b.getRows() != t_t.getRows()) throw ("Rows of right-hand side don't match!");
+		if (t_unit) return;
+		for (length_type i = 0; i < t_t.getRows(); i++)
+			if (t_t.data()[i * t_t.stride() + i] == value_type(0)) throw ("Matrix with zero determinant!");
+	}
+}
+
+LU::LU (const Matrix& t_matrix) : m_lu(t_matrix) {
+	if (t_matrix.getRows() != t_matrix.getColumns()) throw ("Only square matrices can be factored!");
+	m_lu.removeSeperators();
+	m_factor();
+}
+
+LU::LU (const ConstMatrixView& t_matrix) : m_lu(t_matrix) {
+	if (t_matrix.getRows() != t_matrix.getColumns()) throw ("Only square matrices can be factored!");
+	m_factor();
+}
+
+LU::length_type LU::size () const {
+	return m_lu.getRows();
+}
+
+bool LU::isSingular () const {
+	return m_singular;
+}
+
+LU::value_type LU::determinant () const {
+	length_type n = size();
+	const value_type* a = m_lu.data();
+	std::size_t lda = m_lu.stride();
+	value_type det = value_type(1);
+	for (length_type i = 0; i < n; i++)
+		det *= a[i * lda + i];
+	return m_negate ? -det : det;
+}
+
+std::vector<LU::value_type> LU::solve (const std::vector<value_type>& t_b) const {
+	if (t_b.size() != size()) throw ("Size of right-hand side doesn't match!");
+	if (m_singular) throw ("Matrix with zero determinant!");
+	std::vector<value_type> x(t_b);
+	m_solveInPlace(x.data(), 1, 1);
+	return x;
+}
+
+Matrix LU::solve (const Matrix& t_b) const {
+	if (t_b.getRows() != size()) throw ("Rows of right-hand side don't match!");
+	if (m_singular) throw ("Matrix with zero determinant!");
+	Matrix x(t_b);
+	x.removeSeperators();
+	m_solveInPlace(detail::writableView(x).data(), x.stride(), x.getColumns());
+	return x;
+}
+
+Matrix LU::solve (const ConstMatrixView& t_b) const {
+	if (t_b.getRows() != size()) throw ("Rows of right-hand side don't match!");
+	if (m_singular) throw ("Matrix with zero determinant!");
+	Matrix x(t_b);
+	m_solveInPlace(detail::writableView(x).data(), x.stride(), x.getColumns());
+	return x;
+}
+
+void LU::solveInPlace (const MatrixView& t_b) const {
+	if (t_b.getRows() != size()) throw ("Rows of right-hand side don't match!");
+	if (m_singular) throw ("Matrix with zero determinant!");
+	m_solveInPlace(t_b.data(), t_b.stride(), t_b.getColumns());
+}
+
+Matrix LU::inverse () const {
+	if (m_singular) throw ("Matrix with zero determinant!");
+	Matrix x(size());
+	x.identity();
+	m_solveInPlace(detail::writableView(x).data(), x.stride(), x.getColumns());
+	return x;
+}
+
+const Matrix& LU::factors () const {
+	return m_lu;
+}
+
+const std::vector<LU::length_type>& LU::pivots () const {
+	return m_pivots;
+}
+
+void LU::m_factor () {
+	// right-looking blocked elimination: factor a panel of BLOCK columns, then update the trailing matrix with one GEMM
+	length_type n = size();
+	value_type* a = detail::writableView(m_lu).data();
+	std::size_t lda = m_lu.stride();
+	m_pivots.resize(n);
+
+	for (length_type k0 = 0; k0 < n; k0 += BLOCK) {
+		length_type k1 = std::min(n, k0 + BLOCK);
+
+		for (length_type j = k0; j < k1; j++) {
+			length_type pivot = j;
+			value_type largest = std::fabs(a[j * lda + j]);
+			for (length_type i = j + 1; i < n; i++)
+				if (std::fabs(a[i * lda + j]) > largest) { largest = std::fabs(a[i * lda + j]); pivot = i; }
+			m_pivots[j] = pivot;
+			if (largest == value_type(0)) { m_singular = true; continue; }	// column already eliminated
+			if (pivot != j) {	// whole rows are swapped, so earlier L columns follow along
+				std::swap_ranges(a + j * lda, a + j * lda + n, a + pivot * lda);
+				m_negate = !m_negate;
+			}
+			const value_type* pivot_row = a + j * lda;
+			for (length_type i = j + 1; i < n; i++) {
+				value_type* row = a + i * lda;
+				value_type multiple = row[j] /= pivot_row[j];
+				for (length_type c = j + 1; c < k1; c++)
+					row[c] -= multiple * pivot_row[c];
+			}
+		}
+		if (k1 == n) break;
+
+		// U12 = L11^-1 * A12, split by columns of the trailing block
+		split(n - k1, std::size_t(k1 - k0) * (n - k1), [&] (std::size_t t_first, std::size_t t_last) {
+			length_type c0 = k1 + length_type(t_first), c1 = k1 + length_type(t_last);
+			for (length_type j = k0; j < k1; j++) {
+				const value_type* source = a + j * lda;
+				for (length_type i = j + 1; i < k1; i++) {
+					value_type* row = a + i * lda;
+					value_type multiple = row[j];
+					for (length_type c = c0; c < c1; c++)
+						row[c] -= multiple * source[c];
+				}
+			}
+		});
+
+		// A22 -= L21 * U12
+		detail::gemm(n - k1, n - k1, k1 - k0, value_type(-1), a + k1 * lda + k0, lda,
+				a + k0 * lda + k1, lda, value_type(1), a + k1 * lda + k1, lda);
+	}
+}
+
+void LU::m_solveInPlace (value_type* t_b, std::size_t t_ldb, length_type t_columns) const {
+	length_type n = size();
+	split(t_columns, std::size_t(n) * t_columns, [&] (std::size_t t_first, std::size_t t_last) {
+		for (length_type i = 0; i < n; i++)
+			if (m_pivots[i] != i)
+				std::swap_ranges(t_b + i * t_ldb + t_first, t_b + i * t_ldb + t_last, t_b + m_pivots[i] * t_ldb + t_first);
+	});
+	lowerSolve(m_lu.data(), m_lu.stride(), n, t_b, t_ldb, t_columns, true);	// L * y = P * b
+	upperSolve(m_lu.data(), m_lu.stride(), n, t_b, t_ldb, t_columns, false);	// U * x = y
+}
+
+void m::solve (const Matrix& t_a, const MatrixView& t_b) {
+	LU(t_a).solveInPlace(t_b);
+}
+
+void m::solve (const ConstMatrixView& t_a, const MatrixView& t_b) {
+	LU(t_a).solveInPlace(t_b);
+}
+
+Matrix m::solve (const Matrix& t_a, const Matrix& t_b) {
+	return LU(t_a).solve(t_b);
+}
+
+std::vector<Matrix::value_type> m::solve (const Matrix& t_a, const std::vector<Matrix::value_type>& t_b) {
+	return LU(t_a).solve(t_b);
+}
+
+void m::solveLower (const ConstMatrixView& t_t, const MatrixView& t_b, bool t_unit_diagonal) {
+	checkTriangular(t_t, t_b, t_unit_diagonal);
+	lowerSolve(t_t.data(), t_t.stride(), t_t.getRows(), t_b.data(), t_b.stride(), t_b.getColumns(), t_unit_diagonal);
+}
+
+void m::solveUpper (const ConstMatrixView& t_t, const MatrixView& t_b, bool t_unit_diagonal) {
+	checkTriangular(t_t, t_b, t_unit_diagonal);
+	upperSolve(t_t.data(), t_t.stride(), t_t.getRows(), t_b.data(), t_b.stride(), t_b.getColumns(), t_unit_diagonal);
+}
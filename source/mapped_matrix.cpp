@@ -0,0 +1,106 @@
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mapped_matrix.h"
+#include "matrix_file.h"
+
+using namespace m;
+
+MappedMatrix::MappedMatrix (const std::string& t_path) {
+	int file = ::open(t_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file < 0) throw ("Couldn't open matrix file!");
+	struct stat status;
+	if (::fstat(file, &status) != 0 || status.st_size < off_t(sizeof(detail::FileHeader))) {
+		::close(file);
+		throw ("Not a matrix file!");
+	}
+	m_size = std::size_t(status.st_size);
+	m_map = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);	// the mapping keeps the file alive
+	if (m_map == MAP_FAILED) {
+		m_map = nullptr;
+		throw ("Couldn't map matrix file!");
+	}
+
+	try {
+		const unsigned char* bytes = static_cast<const unsigned char*>(m_map);
+		detail::FileHeader header;
+		std::memcpy(&header, bytes, sizeof(header));
+		if (std::memcmp(header.magic, detail::file_magic, sizeof(header.magic)) != 0) throw ("Not a matrix file!");
+		if (header.version != detail::file_version || header.byte_order != detail::file_byte_order
+				|| header.dtype != detail::file_dtype_float32)
+			throw ("Unsupported matrix file!");
+		if (header.rows == 0 || header.columns == 0) throw ("Number of rows and columns must be positive!");
+		if (header.stride < header.columns || header.payload % detail::file_alignment != 0
+				|| header.payload < detail::filePayloadOffset(header.seperators))
+			throw ("Not a matrix file!");
+		if (header.payload > m_size || (m_size - header.payload) / sizeof(value_type) / header.stride < header.rows)
+			throw ("Matrix file is truncated!");
+
+		m_seperators.resize(header.seperators);
+		if (header.seperators)
+			std::memcpy(m_seperators.data(), bytes + sizeof(header), header.seperators * sizeof(uint32_t));
+		for (length_type seperator : m_seperators)
+			if (seperator >= header.columns) throw ("Not a matrix file!");
+		m_rows = header.rows;
+		m_columns = header.columns;
+		m_stride = std::size_t(header.stride);
+		m_cells = reinterpret_cast<const value_type*>(bytes + header.payload);
+	} catch (...) {
+		m_unmap();
+		throw;
+	}
+}
+
+MappedMatrix::MappedMatrix (MappedMatrix&& t_matrix) noexcept : m_map(t_matrix.m_map), m_size(t_matrix.m_size),
+		m_cells(t_matrix.m_cells), m_rows(t_matrix.m_rows), m_columns(t_matrix.m_columns),
+		m_stride(t_matrix.m_stride), m_seperators(std::move(t_matrix.m_seperators)) {
+	t_matrix.m_map = nullptr;
+	t_matrix.m_size = 0;
+	t_matrix.m_cells = nullptr;
+	t_matrix.m_rows = t_matrix.m_columns = 0;
+	t_matrix.m_stride = 0;
+}
+
+MappedMatrix& MappedMatrix::operator= (MappedMatrix&& t_matrix) noexcept {
+	if (this == &t_matrix) return *this;
+	m_unmap();
+	std::swap(m_map, t_matrix.m_map);
+	std::swap(m_size, t_matrix.m_size);
+	std::swap(m_cells, t_matrix.m_cells);
+	std::swap(m_rows, t_matrix.m_rows);
+	std::swap(m_columns, t_matrix.m_columns);
+	std::swap(m_stride, t_matrix.m_stride);
+	m_seperators = std::move(t_matrix.m_seperators);
+	return *this;
+}
+
+MappedMatrix::length_type MappedMatrix::getRows () const {
+	return m_rows;
+}
+
+MappedMatrix::length_type MappedMatrix::getColumns () const {
+	return m_columns;
+}
+
+const std::vector<MappedMatrix::length_type>& MappedMatrix::seperators () const {
+	return m_seperators;
+}
+
+ConstMatrixView MappedMatrix::view () const {
+	return ConstMatrixView(m_cells, m_rows, m_columns, m_stride);
+}
+
+MappedMatrix::~MappedMatrix () {
+	m_unmap();
+}
+
+void MappedMatrix::m_unmap () {
+	if (m_map) ::munmap(m_map, m_size);
+	m_map = nullptr;
+	m_size = 0;
+	m_cells = nullptr;
+}
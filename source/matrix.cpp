@@ -1,110 +1,189 @@
 #include <iostream>
-#include <iomanip>
+#include <fstream>
 #include <vector>
 #include <limits>
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <thread>
 #include "matrix.h"
+#include "lu.h"
+#include "mapped_matrix.h"
+#include "matrix_file.h"
+#include "gemm.h"
+#include "transpose.h"
+#include "strassen.h"
+#include "thread_pool.h"
 
 using namespace m;
 
-Matrix::length_type Matrix::m_matrices_count = 0;
+std::atomic<Matrix::length_type> Matrix::m_matrices_count {0};
 int Matrix::m_precision = 3;
+Matrix::product_type Matrix::m_product_type = Matrix::product_type::classical;
+Matrix::length_type Matrix::m_strassen_crossover = 1024;
+
+namespace {
+	/* every buffer starts with a header, one alignment block long so the cells after it stay aligned,
+	  counting the matrices holding it. Copies hold the buffer of the original until one of them is changed,
+	  unless a mutable view or data() pointer was handed out for it (leaked): that one may be written
+	  through at any time, so copies of a leaked buffer copy its cells */
+	struct BufferHeader {
+		std::atomic<std::size_t> references;
+		std::atomic<bool> leaked {false};
+		explicit BufferHeader (std::size_t t_references) : references(t_references) {}
+	};
+	constexpr std::size_t header_bytes = Matrix::alignment;
+
+	BufferHeader* header (const Matrix::value_type* t_cells) {
+		return reinterpret_cast<BufferHeader*>(const_cast<char*>(reinterpret_cast<const char*>(t_cells)) - header_bytes);
+	}
+
+	/* the buffer the last multiply() on this thread computed into; the matrix's previous buffer takes its
+	  place. Only buffers of the heap resource are traded, any thread may free those */
+	struct ProductScratch {
+		Matrix::value_type* data {nullptr};
+		std::size_t capacity {0};
+		ProductScratch () = default;
+		ProductScratch (const ProductScratch&) = delete;
+		ProductScratch& operator= (const ProductScratch&) = delete;
+		~ProductScratch () {
+			if (data) std::pmr::new_delete_resource()->deallocate(reinterpret_cast<char*>(data) - header_bytes,
+					header_bytes + capacity * sizeof(Matrix::value_type), Matrix::alignment);
+		}
+	};
+
+	ProductScratch& productScratch () {
+		thread_local ProductScratch scratch;
+		return scratch;
+	}
+
+	// C = A * B, all row-major, the way t_type says
+	void denseProduct (Matrix::length_type t_m, Matrix::length_type t_n, Matrix::length_type t_k,
+			const Matrix::value_type* t_a, std::size_t t_lda, const Matrix::value_type* t_b, std::size_t t_ldb,
+			Matrix::value_type* t_c, std::size_t t_ldc, Matrix::product_type t_type) {
+		if (t_type == Matrix::product_type::strassen)
+			detail::strassen(t_m, t_n, t_k, t_a, t_lda, t_b, t_ldb, t_c, t_ldc, Matrix::getStrassenCrossover());
+		else
+			detail::gemm(t_m, t_n, t_k, Matrix::value_type(1), t_a, t_lda, t_b, t_ldb, Matrix::value_type(0), t_c, t_ldc);
+	}
+
+	// calls t_body(first_row, last_row) over blocks of [0, t_rows), across the pool when the matrix is big enough
+	template <class Body>
+	void forRowBlocks (Matrix::length_type t_rows, Matrix::length_type t_columns, Body&& t_body) {
+		detail::ThreadPool& pool = detail::ThreadPool::instance();
+		std::size_t grain = std::max<std::size_t>(1, detail::parallel_cells / std::max<Matrix::length_type>(t_columns, 1));
+		if (pool.size() <= 1 || t_rows <= grain) { t_body(Matrix::length_type(0), t_rows); return; }
+		pool.parallelFor(0, t_rows, grain, [&t_body] (std::size_t t_first, std::size_t t_last) {
+			t_body(Matrix::length_type(t_first), Matrix::length_type(t_last));
+		});
+	}
+}
 
 Matrix::Matrix (length_type t_length) : m_rows(t_length), m_columns(t_length) {
-	m_matrices_count++;
 	if (t_length == 0) throw ("Number of rows and columns must be positive!");
-	m_matrix.resize(m_rows, row_type{});
-	for (auto& row : m_matrix)
-		row.resize(m_columns, value_type(0));
-	m_determinant = new value_type;
-	*m_determinant = value_type{0};
+	m_allocate(m_rows, m_columns);
+	m_matrices_count++;
+	m_setDeterminant(value_type{0});
 }
 
 Matrix::Matrix (length_type  t_rows, length_type t_columns) : m_rows(t_rows), m_columns(t_columns) { 
-	m_matrices_count++;
 	if (t_rows == 0 || t_columns == 0) throw ("Number of rows and columns must be positive!");
-	m_matrix.resize(m_rows, row_type{});
-	for (auto& row : m_matrix)
-		row.resize(m_columns, value_type(0));
+	m_allocate(m_rows, m_columns);
+	m_matrices_count++;
 	if (m_rows == m_columns) {
-		m_determinant = new value_type;
-		*m_determinant = value_type(0);
+		m_setDeterminant(value_type(0));
 	}
 }
 
-Matrix::Matrix (const Matrix& t_matrix) : m_rows(t_matrix.m_rows), m_columns(t_matrix.m_columns) { 
+Matrix::Matrix (length_type t_rows, length_type t_columns, std::pmr::memory_resource* t_resource)
+		: m_rows(t_rows), m_columns(t_columns), m_resource(t_resource) {
+	if (t_rows == 0 || t_columns == 0) throw ("Number of rows and columns must be positive!");
+	m_allocate(m_rows, m_columns);
 	m_matrices_count++;
-	m_matrix.resize(m_rows, row_type{});
-	for (length_type i = 0; i < m_rows; i++) {
-		m_matrix[i] = t_matrix.m_matrix[i];
-	}
-	if (t_matrix.m_determinant) {
-		m_determinant = new value_type;
-		*m_determinant = *t_matrix.m_determinant;
+	if (m_rows == m_columns) m_setDeterminant(value_type(0));
+}
+
+Matrix::Matrix (const Matrix& t_matrix) : Matrix(t_matrix, currentResource()) {}
+
+Matrix::Matrix (const Matrix& t_matrix, std::pmr::memory_resource* t_resource) : MatrixExpression<Matrix>(),
+		m_rows(t_matrix.m_rows), m_columns(t_matrix.m_columns), m_stride(t_matrix.m_stride),
+		m_aug_sep(t_matrix.m_aug_sep), m_resource(t_resource) {
+	m_matrices_count++;
+	if (m_shareable(t_matrix)) m_share(t_matrix);
+	else {	// a buffer of another resource can't be given back through this one, nor a leaked one shared
+		m_capacity = std::size_t(m_rows) * m_stride;
+		M_INSTRUMENT(copy, 0, 2.0 * sizeof(value_type) * double(m_capacity));
+		m_data = m_allocateBuffer(m_capacity);
+		std::memcpy(m_data, t_matrix.m_data, m_capacity * sizeof(value_type));
 	}
-	m_aug_sep = t_matrix.m_aug_sep;
+	if (t_matrix.m_hasDeterminant()) m_setDeterminant(t_matrix.m_determinant);
+}
+
+Matrix::Matrix (Matrix&& t_matrix) noexcept : MatrixExpression<Matrix>(), m_data(t_matrix.m_data),
+		m_rows(t_matrix.m_rows), m_columns(t_matrix.m_columns), m_stride(t_matrix.m_stride),
+		m_capacity(t_matrix.m_capacity), m_aug_sep(std::move(t_matrix.m_aug_sep)), m_resource(t_matrix.m_resource) {
+	m_matrices_count++;
+	if (t_matrix.m_hasDeterminant()) m_setDeterminant(t_matrix.m_determinant);
+	t_matrix.m_data = nullptr;
+	t_matrix.m_dropDeterminant();
+	t_matrix.m_rows = t_matrix.m_columns = t_matrix.m_stride = 0;
+	t_matrix.m_capacity = 0;
 }
 
 Matrix::Matrix (const Matrix& t_matrix, length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) \
-		: m_rows(t_i1 - t_i0 + 1), m_columns(t_j1 - t_j0 + 1) {
-		m_matrices_count++;
+		: MatrixExpression<Matrix>(), m_rows(t_i1 - t_i0 + 1), m_columns(t_j1 - t_j0 + 1) {
 		if (t_i0 > t_i1 || t_j0 > t_j1)
 			throw("Number of rows and columns of submatrix must be positive!");
 		if (t_i1 >= t_matrix.m_rows || t_j1 >= t_matrix.m_columns)
 			throw("Rows and Columns of submatrix must be contained in the main matrix!");
-		m_matrix.resize(m_rows, row_type{});
-		for (length_type i = t_i0; i <= t_i1; i++) {
-			m_matrix[i - t_i0].resize(m_columns);
-			for (length_type j = t_j0; j <= t_j1; j++)
-				m_matrix[i - t_i0][j - t_j0] = t_matrix.m_matrix[i][j];
-		}
+		M_INSTRUMENT(copy, 0, 2.0 * sizeof(value_type) * m_rows * m_columns);
+		m_allocate(m_rows, m_columns);
+		m_matrices_count++;		// once nothing can throw, as the destructor doesn't run after a throw
+		for (length_type i = t_i0; i <= t_i1; i++)
+			std::memcpy(m_row(i - t_i0), t_matrix.m_row(i) + t_j0, m_columns * sizeof(value_type));
 		for (length_type i = 0; i < t_matrix.m_aug_sep.size(); i++) {
 			if (t_matrix.m_aug_sep[i] < t_j0) continue;
 			if (t_matrix.m_aug_sep[i] >= t_j1) break;
 			m_aug_sep.push_back(t_matrix.m_aug_sep[i] - t_j0);
 		}
-		if (m_determinant) {
-			delete m_determinant;
-			m_determinant = nullptr;
-		}
+		m_dropDeterminant();
+}
+
+Matrix::Matrix (length_type t_rows, length_type t_columns, m_no_fill) : m_rows(t_rows), m_columns(t_columns) {
+	if (t_rows == 0 || t_columns == 0) throw ("Number of rows and columns must be positive!");
+	m_allocate(m_rows, m_columns, false);
+	m_matrices_count++;
+}
+
+Matrix::Matrix (const TransposedView& t_view) : Matrix(t_view.getRows(), t_view.getColumns(), m_no_fill{}) {
+	const ConstMatrixView& cells = t_view.transposed();
+	M_INSTRUMENT(transpose, 0, 2.0 * sizeof(value_type) * m_rows * m_columns);
+	detail::transposeCopy(cells.data(), cells.stride(), cells.getRows(), cells.getColumns(), m_data, m_stride);
+	for (length_type i = 0; i < m_rows && m_stride != m_columns; i++)
+		std::fill(m_row(i) + m_columns, m_row(i) + m_stride, value_type(0));
 }
 
 void Matrix::identity () {
 	if (m_rows != m_columns) throw ("Not square matrix!");
+	m_unshare(false);
 	for (length_type i = 0; i < m_rows; i++) {
-		m_matrix[i].assign(m_columns, value_type(0));
-		m_matrix[i][i] = value_type(1);
+		std::fill_n(m_row(i), m_columns, value_type(0));
+		m_row(i)[i] = value_type(1);
 	}
-	if (!m_determinant) m_determinant = new value_type;
-	*m_determinant = value_type{1};
+	m_setDeterminant(value_type{1});
 }
 
 void Matrix::fill (value_type t_constant) {
+	m_unshare(false);
 	for (length_type i = 0; i < m_rows; i++)
-			m_matrix[i].assign(m_columns, t_constant);
+		std::fill_n(m_row(i), m_columns, t_constant);
 	if (m_rows == m_columns) {
-		if (!m_determinant) m_determinant = new value_type;
-	   	*m_determinant = value_type{0};
+		m_setDeterminant(value_type{0});
 	}
 }
 
 void Matrix::print () const {
-	std::cout << '\n';
-	length_type index { 0 };
-	std::cout << std::scientific << std::setprecision(m_precision);
-	for (length_type i = 0; i < m_rows; i++) {
-		std::cout << "[ ";
-		for (length_type j = 0; j < m_columns; j++) {
-			if (m_matrix[i][j] >= 0) std::cout << ' ';
-			std::cout << m_matrix[i][j] << ' ';
-			if (!m_aug_sep.empty() && m_aug_sep[index] == j) {
-				std::cout << "| ";
-				index++;
-			}
-		}
-		index = 0;
-		std::cout << "]\n";
-	}
-	std::cout << '\n';
+	detail::printCells(view(), m_aug_sep);
 } 
 
 void Matrix::print (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) const {
@@ -112,27 +191,61 @@ void Matrix::print (length_type t_i0, length_type t_j0, length_type t_i1, length
 		throw("Number of rows and columns must be positive!");
 	if (t_i1 >= m_rows || t_j1 >= m_columns)
 		throw("Rows and Columns of submatrix must be contained in the main matrix!");
-	std::cout << '\n';
-	length_type index { 0 };
-	std::cout << std::scientific << std::setprecision(m_precision);
-	for (length_type i = t_i0; i <= t_i1; i++) {
-		std::cout << "[ ";
-		for (length_type j = t_j0; j <= t_j1; j++) {
-			if (m_matrix[i][j] >= 0) std::cout << ' ';
-			std::cout << m_matrix[i][j] << ' ';
-			if (!m_aug_sep.empty() && j != t_j1 && m_aug_sep[index] == j) {
-				std::cout << "| ";
-				index++;
-			}
-		}
-		index = 0;
-		std::cout << "]\n";
-	}
-	std::cout << '\n';
+	std::vector<length_type> seperators;	// the ones inside the printed columns, counted from t_j0
+	for (length_type seperator : m_aug_sep)
+		if (seperator >= t_j0 && seperator < t_j1) seperators.push_back(seperator - t_j0);
+	detail::printCells(view(t_i0, t_j0, t_i1, t_j1), seperators);
 } 
 
+MatrixView Matrix::view (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) {
+	return view().view(t_i0, t_j0, t_i1, t_j1);
+}
+
+ConstMatrixView Matrix::view (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) const {
+	return view().view(t_i0, t_j0, t_i1, t_j1);
+}
+
+MatrixView Matrix::view () {
+	m_leak();
+	m_dropDeterminant();	// cells may be written through the view
+	return MatrixView(m_data, m_rows, m_columns, m_stride);
+}
+
+ConstMatrixView Matrix::view () const {
+	return ConstMatrixView(m_data, m_rows, m_columns, m_stride);
+}
+
+MatrixView Matrix::row (length_type t_row) {
+	return view().row(t_row);
+}
+
+ConstMatrixView Matrix::row (length_type t_row) const {
+	return view().row(t_row);
+}
+
+MatrixView Matrix::column (length_type t_column) {
+	return view().column(t_column);
+}
+
+ConstMatrixView Matrix::column (length_type t_column) const {
+	return view().column(t_column);
+}
+
+MatrixView Matrix::section (length_type t_index) {
+	length_type first, last;
+	m_sectionBounds(t_index, first, last);
+	return view(0, first, m_rows - 1, last);
+}
+
+ConstMatrixView Matrix::section (length_type t_index) const {
+	length_type first, last;
+	m_sectionBounds(t_index, first, last);
+	return view(0, first, m_rows - 1, last);
+}
+
 void Matrix::resize (length_type t_new_rows, length_type t_new_columns) {
 	if (t_new_rows == m_rows && t_new_columns == m_columns) return;
+	M_INSTRUMENT(resize, 0, 2.0 * sizeof(value_type) * std::min(m_rows, t_new_rows) * std::min(m_columns, t_new_columns));
 
 	// removing out-of-bounds speerators
 	if (t_new_columns < m_columns) for (length_type i = 0; i < m_aug_sep.size(); i++) if (m_aug_sep[i] >= t_new_columns - 1) {
@@ -140,15 +253,17 @@ void Matrix::resize (length_type t_new_rows, length_type t_new_columns) {
 		 break;
 	}
 
+	value_type* old_data = m_data;
+	length_type old_stride = m_stride;
+	std::size_t old_capacity = m_capacity;
+	length_type kept_rows = std::min(m_rows, t_new_rows), kept_columns = std::min(m_columns, t_new_columns);
+	m_allocate(t_new_rows, t_new_columns);
+	for (length_type i = 0; i < kept_rows; i++)
+		std::memcpy(m_row(i), old_data + std::size_t(i) * old_stride, kept_columns * sizeof(value_type));
+	m_freeBuffer(old_data, old_capacity);
 	m_rows = t_new_rows;
 	m_columns = t_new_columns;
-	m_matrix.resize(m_rows, row_type{});
-	for (auto& row : m_matrix)
-		row.resize(m_columns, value_type(0));
-	if (m_determinant) {
-		delete m_determinant;
-		m_determinant = nullptr;
-	}
+	m_dropDeterminant();
 }
 
 void Matrix::enter (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) {
@@ -156,184 +271,314 @@ void Matrix::enter (length_type t_i0, length_type t_j0, length_type t_i1, length
 		throw("Number of rows and columns of submatrix must be positive!");
 	if (t_i1 >= m_rows || t_j1 >= m_columns)
 		throw("Rows and columns of submatrix must be contained in the main matrix!");
+	m_unshare();
 	for (length_type i = t_i0; i <= t_i1; i++) {
 		for (length_type j = t_j0; j <= t_j1; j++) {
 			std::cout << '[' << i << "][" << j << "]: ";
-			std::cin >> m_matrix[i][j];
+			std::cin >> m_row(i)[j];
 			while (std::cin.fail()) {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits <std::streamsize>::max(), '\n');
 				std::cout << "Invalid input.\n";
 				std::cout << '[' << i << "][" << j << "]: ";
-				std::cin >> m_matrix[i][j];
+				std::cin >> m_row(i)[j];
 			}
 			std::cin.clear();
 			std::cin.ignore(std::numeric_limits <std::streamsize>::max(), '\n');
 		}
 	}
-	if (m_determinant) {
-		delete m_determinant;
-		m_determinant = nullptr;
-	}
+	m_dropDeterminant();
 }
 
 void Matrix::enter () {
+	m_unshare();
 	for (length_type i = 0; i < m_rows; i++) {
 		for (length_type j = 0; j < m_columns; j++) {
 			std::cout << '[' << i << "][" << j << "]: ";
-			std::cin >> m_matrix[i][j];
+			std::cin >> m_row(i)[j];
 			while (std::cin.fail()) {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits <std::streamsize>::max(), '\n');
 				std::cout << "Invalid input.\n";
 				std::cout << '[' << i << "][" << j << "]: ";
-				std::cin >> m_matrix[i][j];
+				std::cin >> m_row(i)[j];
 			}
 			std::cin.clear();
 			std::cin.ignore(std::numeric_limits <std::streamsize>::max(), '\n');
 		}
 	}
-	if (m_determinant) {
-		delete m_determinant;
-		m_determinant = nullptr;
-	}
+	m_dropDeterminant();
+}
+
+void Matrix::save (const std::string& t_path) const {
+	std::ofstream file(t_path, std::ios::binary | std::ios::trunc);
+	if (!file) throw ("Couldn't open matrix file!");
+	detail::FileHeader header {};
+	std::memcpy(header.magic, detail::file_magic, sizeof(header.magic));
+	header.version = detail::file_version;
+	header.byte_order = detail::file_byte_order;
+	header.dtype = detail::file_dtype_float32;
+	header.rows = m_rows;
+	header.columns = m_columns;
+	header.seperators = uint32_t(m_aug_sep.size());
+	header.stride = m_stride;
+	header.payload = detail::filePayloadOffset(m_aug_sep.size());
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(m_aug_sep.data()), std::streamsize(m_aug_sep.size() * sizeof(uint32_t)));
+	static const char zeros[alignment] = {};
+	file.write(zeros, std::streamsize(header.payload - sizeof(header) - m_aug_sep.size() * sizeof(uint32_t)));
+
+	// the buffer goes out as it lies in memory; padding cells at the end of rows are written as zeros
+	if (m_stride == m_columns)
+		file.write(reinterpret_cast<const char*>(m_data), std::streamsize(std::size_t(m_rows) * m_stride * sizeof(value_type)));
+	else for (length_type i = 0; i < m_rows; i++) {
+		file.write(reinterpret_cast<const char*>(m_row(i)), std::streamsize(m_columns * sizeof(value_type)));
+		file.write(zeros, std::streamsize((m_stride - m_columns) * sizeof(value_type)));
+	}
+	file.flush();
+	if (!file) throw ("Couldn't write matrix file!");
+}
+
+Matrix Matrix::load (const std::string& t_path) {
+	MappedMatrix file(t_path);
+	Matrix res(file.view());
+	res.m_aug_sep = file.seperators();
+	return res;
 }
 
 void Matrix::rowOperation (row_op_type t_operation_type, length_type t_row0, length_type t_row1, value_type t_multiple) {
 	if (t_row0 >= m_rows || t_row1 >= m_rows) throw("Rows must be contained in the main matrix!");
+	m_unshare();
 	switch (t_operation_type) {
 		case row_op_type::swap:
 			if (t_row0 == t_row1) break;
-			m_matrix[t_row0].swap(m_matrix[t_row1]);
-			if (m_determinant) *m_determinant *= value_type(-1);
+			std::swap_ranges(m_row(t_row0), m_row(t_row0) + m_columns, m_row(t_row1));
+			if (m_hasDeterminant()) m_determinant *= value_type(-1);
 			break;
-		case row_op_type::scale:
+		case row_op_type::scale: {
+			value_type* row = m_row(t_row0);
 			for (length_type i = 0; i < m_columns; i++) {
-				m_matrix[t_row0][i] *= t_multiple;
+				row[i] *= t_multiple;
 			}
-			if (m_determinant) *m_determinant *= t_multiple;
+			if (m_hasDeterminant()) m_determinant *= t_multiple;
 			break;
-		case row_op_type::add_multiple:
+		}
+		case row_op_type::add_multiple: {
+			const value_type* source = m_row(t_row0);
+			value_type* target = m_row(t_row1);
 			for (length_type i = 0; i < m_columns; i++) {
-				m_matrix[t_row1][i] += m_matrix[t_row0][i] * t_multiple;
+				target[i] += source[i] * t_multiple;
 			}
 			break;
+		}
 		default:
 			break;
 	}
 }
 
 Matrix& Matrix::echelon () {
-	bool non_zero_found = false;
+	M_INSTRUMENT(echelon, 2.0 / 3 * m_rows * m_columns * std::min(m_rows, m_columns), 2.0 * sizeof(value_type) * m_rows * m_columns);
+	// blocked right-looking elimination: a panel of columns is eliminated first (multipliers are parked in the
+	// cells they zero), then the rest of the matrix to its right is brought up to date with one GEMM
+	m_unshare();
+	value_type* a = m_data;
+	std::size_t lda = m_stride;
 	length_type row_limiter = 0;
+	std::vector<length_type> pivot_columns;
+	std::vector<value_type> multipliers;
 
 	// setup for determinant
 	if (m_rows == m_columns) {
-		if (!m_determinant) m_determinant = new value_type;
-		*m_determinant = value_type(1);
-	}
-
-	for (length_type j = 0; j < m_columns && row_limiter < m_rows; j++) {
-		row_limiter += (non_zero_found ? 1 : 0);
-		non_zero_found = false;
-		for (length_type i = row_limiter; i < m_rows; i++) {	// non_zero_found is set to true when first non zero element is met in current column
-			if (m_matrix[i][j] == 0) continue;
-			if (!non_zero_found) {
-				non_zero_found = true;
-				if (i != row_limiter) rowOperation(row_op_type::swap, i, row_limiter);
+		m_setDeterminant(value_type(1));
+	}
+
+	for (length_type j0 = 0; j0 < m_columns && row_limiter < m_rows; ) {
+		length_type j1 = std::min(m_columns, j0 + m_elimination_block);
+		length_type r0 = row_limiter;
+		pivot_columns.clear();
+
+		for (length_type j = j0; j < j1 && row_limiter < m_rows; j++) {
+			length_type first = row_limiter;	// first non zero element in current column becomes the pivot
+			while (first < m_rows && a[first * lda + j] == value_type(0)) first++;
+			if (first == m_rows) {
+				if (m_hasDeterminant()) m_determinant *= a[row_limiter * lda + j];
 				continue;
 			}
-			rowOperation(row_op_type::add_multiple, row_limiter, i, value_type(-1) * m_matrix[i][j] / m_matrix[row_limiter][j]);
+			if (first != row_limiter) rowOperation(row_op_type::swap, first, row_limiter);
+			const value_type* pivot_row = a + row_limiter * lda;
+			length_type below = row_limiter + 1;
+			forRowBlocks(m_rows - below, j1 - j, [&] (length_type t_first, length_type t_last) {
+				for (length_type i = below + t_first; i < below + t_last; i++) {
+					value_type* row = a + i * lda;
+					if (row[j] == value_type(0)) continue;
+					value_type multiple = row[j] /= pivot_row[j];
+					for (length_type c = j + 1; c < j1; c++)
+						row[c] -= multiple * pivot_row[c];
+				}
+			});
+			if (m_hasDeterminant()) m_determinant *= pivot_row[j];
+			pivot_columns.push_back(j);
+			row_limiter++;
+		}
+
+		length_type pivots = length_type(pivot_columns.size());
+		if (pivots > 0 && j1 < m_columns) {
+			// pivot rows of the panel: U12 = L11^-1 * A12
+			forRowBlocks(m_columns - j1, pivots, [&] (length_type t_first, length_type t_last) {
+				for (length_type t = 0; t < pivots; t++) {
+					const value_type* source = a + (r0 + t) * lda;
+					for (length_type s = t + 1; s < pivots; s++) {
+						value_type* row = a + (r0 + s) * lda;
+						value_type multiple = row[pivot_columns[t]];
+						if (multiple == value_type(0)) continue;
+						for (length_type c = j1 + t_first; c < j1 + t_last; c++)
+							row[c] -= multiple * source[c];
+					}
+				}
+			});
+			// rows below them: A22 -= L21 * U12
+			length_type top = r0 + pivots, below = m_rows - top;
+			if (below > 0) {
+				multipliers.resize(std::size_t(below) * pivots);
+				for (length_type i = 0; i < below; i++)
+					for (length_type t = 0; t < pivots; t++)
+						multipliers[std::size_t(i) * pivots + t] = a[(top + i) * lda + pivot_columns[t]];
+				detail::gemm(below, m_columns - j1, pivots, value_type(-1), multipliers.data(), pivots,
+						a + r0 * lda + j1, lda, value_type(1), a + top * lda + j1, lda);
+			}
 		}
-		if (m_determinant) *m_determinant *= m_matrix[row_limiter][j];
+		// the multipliers are spent; what they stood for is exactly zero
+		for (length_type t = 0; t < pivots; t++)
+			for (length_type i = r0 + t + 1; i < m_rows; i++)
+				a[i * lda + pivot_columns[t]] = value_type(0);
+		j0 = j1;
 	}
 	return *this;
 }
 
 Matrix& Matrix::reduced_echelon () {
+	M_INSTRUMENT(reduced_echelon, double(m_rows) * m_columns * std::min(m_rows, m_columns), 2.0 * sizeof(value_type) * m_rows * m_columns);
 	echelon();
+	value_type* a = m_data;
+	std::size_t lda = m_stride;
+
+	// leading non zero element of every non zero row; in echelon form those rows are 0 .. rank - 1
+	std::vector<length_type> pivot_columns;
 	length_type column_limiter {m_columns};
-	for (length_type row = m_rows - 1; row + 1 != 0; row--) {
-		for (length_type j = 0; j < column_limiter; j++) {
-			if (m_matrix[row][j] != value_type(0)) {
+	for (length_type row = m_rows - 1; row + 1 != 0; row--)
+		for (length_type j = 0; j < column_limiter; j++)
+			if (a[row * lda + j] != value_type(0)) {
 				column_limiter = j;
-				for (length_type i = 0; i < row; i++)
-					rowOperation(row_op_type::add_multiple, row, i, value_type(-1) * m_matrix[i][column_limiter] / m_matrix[row][column_limiter]);
+				pivot_columns.insert(pivot_columns.begin(), j);
 			}
+	length_type rank = length_type(pivot_columns.size());
+
+	// blocks of pivot rows from the bottom up: clear above the pivots inside the block,
+	// then clear the pivot columns of every row above the block with one GEMM
+	std::vector<value_type> multipliers;
+	for (length_type r1 = rank; r1 > 0; ) {
+		length_type r0 = r1 > m_elimination_block ? r1 - m_elimination_block : 0;
+		length_type c0 = pivot_columns[r0];
+		for (length_type r = r1 - 1; r + 1 > r0 + 1; r--) {
+			const value_type* source = a + r * lda;
+			length_type c = pivot_columns[r];
+			for (length_type i = r0; i < r; i++) {
+				value_type* row = a + i * lda;
+				if (row[c] == value_type(0)) continue;
+				value_type multiple = row[c] / source[c];
+				for (length_type k = c + 1; k < m_columns; k++)
+					row[k] -= multiple * source[k];
+				row[c] = value_type(0);
+			}
+		}
+		if (r0 > 0) {
+			length_type pivots = r1 - r0;
+			multipliers.resize(std::size_t(r0) * pivots);
+			for (length_type i = 0; i < r0; i++)
+				for (length_type t = 0; t < pivots; t++)
+					multipliers[std::size_t(i) * pivots + t] = a[i * lda + pivot_columns[r0 + t]] / a[(r0 + t) * lda + pivot_columns[r0 + t]];
+			detail::gemm(r0, m_columns - c0, pivots, value_type(-1), multipliers.data(), pivots,
+					a + r0 * lda + c0, lda, value_type(1), a + c0, lda);
+			for (length_type i = 0; i < r0; i++)
+				for (length_type t = 0; t < pivots; t++)
+					a[i * lda + pivot_columns[r0 + t]] = value_type(0);
 		}
+		r1 = r0;
 	}
 	return *this;
 }
 
 Matrix& Matrix::transpose () { 
-	length_type short_side = 0;
-	length_type tall_side = 0;
-	value_type temp_val;
-	if (m_rows > m_columns) {
-		short_side = m_columns;
-		tall_side = m_rows;
-		m_columns = m_rows;
-		for (length_type i = 0; i < short_side; i++)
-			m_matrix[i].resize(tall_side);
-	} else if (m_columns > m_rows) {
-		short_side = m_rows;
-		tall_side = m_columns;
-		m_rows = m_columns;
-		m_matrix.insert(m_matrix.end(), tall_side - short_side, row_type(short_side));
-	}
-	for (length_type i = 0; i < short_side; i++)
-		for (length_type j = i + 1; j < tall_side; j++) {
-			temp_val = m_matrix[i][j];
-			m_matrix[i][j] = m_matrix[j][i];
-			m_matrix[j][i] = temp_val;
-		}
-	if (short_side == tall_side) return *this; // no need to resize; square matrix
-	if (tall_side == m_rows) {
-		m_rows = short_side;
-		m_matrix.resize(m_rows);
-	}
-	else if (tall_side == m_columns) {
-		m_columns = short_side;
-		for (auto& it : m_matrix)
-			it.resize(m_columns);
-	}
+	M_INSTRUMENT(transpose, 0, 2.0 * sizeof(value_type) * m_rows * m_columns);
+	// a shared buffer is left to its other holders, the cells go transposed to a new one
+	bool shared = m_shared();
+	if (m_rows == m_columns && !shared) {
+		detail::transposeSquare(m_data, m_stride, m_rows);
+		return *this; // no need to reallocate; square matrix
+	}
+	length_type old_rows = m_rows, old_columns = m_columns, stride = m_alignedStride(old_rows);
+	if (std::size_t(old_rows) * old_columns >= m_in_place_transpose && std::size_t(old_columns) * stride <= m_capacity
+			&& !shared) {
+		// in place: rows are packed, the cells permuted, then the new rows spread out to their stride
+		for (length_type i = 1; i < old_rows && m_stride != old_columns; i++)
+			std::memmove(m_data + std::size_t(i) * old_columns, m_row(i), old_columns * sizeof(value_type));
+		detail::transposePacked(m_data, old_rows, old_columns);
+		for (length_type i = old_columns; i-- > 1 && stride != old_rows; )
+			std::memmove(m_data + std::size_t(i) * stride, m_data + std::size_t(i) * old_rows, old_rows * sizeof(value_type));
+		m_stride = stride;
+	}
+	else {
+		value_type* old_data = m_data;
+		length_type old_stride = m_stride;
+		std::size_t old_capacity = m_capacity;
+		m_allocate(old_columns, old_rows, false);
+		detail::transposeCopy(old_data, old_stride, old_rows, old_columns, m_data, m_stride);
+		m_freeBuffer(old_data, old_capacity);
+	}
+	m_rows = old_columns;
+	m_columns = old_rows;
+	for (length_type i = 0; i < m_rows && m_stride != m_columns; i++)	// padding stays zero
+		std::fill(m_row(i) + m_columns, m_row(i) + m_stride, value_type(0));
 	// determinant stays same if exists
 	return *this; 
 }
 
+TransposedView Matrix::transposed () const {
+	return TransposedView(view());
+}
+
 Matrix& Matrix::invert () {
-	value_type inverted_determinant;
 	if (m_rows != m_columns) throw ("Matrix has no inverse!");
-	if (this->getDeterminant() == value_type(0)) throw ("Matrix with zero determinant!");
-	inverted_determinant = this->getDeterminant();
-	Matrix augmented = *this, inverse = Matrix(augmented.m_rows);
-	inverse.identity();
-	augmented.augment(inverse);
-	augmented.reduced_echelon();
-
-	for (length_type i = 0; i < m_rows; i++) { // normalizing to identity in first matrix
-		inverted_determinant /= augmented.m_matrix[i][i];
-		augmented.rowOperation(row_op_type::scale, i, 0, value_type(1) / augmented.m_matrix[i][i]);
-	}
-	augmented.unaugment(0, &inverse);
-	if (!inverse.m_determinant)
-		inverse.m_determinant = new value_type;
-	*inverse.m_determinant = inverted_determinant;
-	*this = inverse;
+	M_INSTRUMENT(invert, 2.0 * m_rows * m_rows * m_rows, 2.0 * sizeof(value_type) * m_rows * m_rows);
+	LU factorization(*this);
+	if (factorization.isSingular()) throw ("Matrix with zero determinant!");
+	value_type determinant = factorization.determinant();
+	*this = factorization.inverse();
+	m_setDeterminant(value_type(1) / determinant);
 	return *this;
 }
 
 void Matrix::augment (const Matrix& t_matrix) {
 	if (m_rows != t_matrix.m_rows) throw ("Number of rows doesn't match!");
-	m_aug_sep.push_back(m_columns - 1);
-	m_aug_sep.insert(m_aug_sep.end(), t_matrix.m_aug_sep.begin(), t_matrix.m_aug_sep.end());
-	m_columns += t_matrix.m_columns;
-	for (length_type i = 0; i < m_rows; i++)
-		m_matrix[i].insert(m_matrix[i].end(), t_matrix.m_matrix[i].begin(), t_matrix.m_matrix[i].end());
-	if (m_determinant) {
-		delete m_determinant;
-		m_determinant = nullptr;
+	M_INSTRUMENT(augment, 0, 2.0 * sizeof(value_type) * m_rows * (m_columns + t_matrix.m_columns));
+	// t_matrix may be this matrix, so what is read of it is kept aside (its cells stay in the old buffer)
+	length_type old_columns = m_columns, old_stride = m_stride;
+	length_type columns = t_matrix.m_columns, stride = t_matrix.m_stride;
+	const value_type* cells = t_matrix.m_data;
+	std::vector<length_type> separators(t_matrix.m_aug_sep);
+	value_type* old_data = m_data;
+	std::size_t old_capacity = m_capacity;
+	m_aug_sep.push_back(old_columns - 1);
+	for (length_type separator : separators)
+		m_aug_sep.push_back(old_columns + separator);
+	m_allocate(m_rows, old_columns + columns);
+	m_columns = old_columns + columns;
+	for (length_type i = 0; i < m_rows; i++) {
+		std::memcpy(m_row(i), old_data + std::size_t(i) * old_stride, old_columns * sizeof(value_type));
+		std::memcpy(m_row(i) + old_columns, cells + std::size_t(i) * stride, columns * sizeof(value_type));
 	}
+	m_freeBuffer(old_data, old_capacity);
+	m_dropDeterminant();
 }
 
 void Matrix::unaugment (length_type t_index, Matrix* t_matrix) {
@@ -341,17 +586,27 @@ void Matrix::unaugment (length_type t_index, Matrix* t_matrix) {
 		throw ("Matrix is already unaugmented!");
 	if (t_index >= m_aug_sep.size()) 
 		throw ("Augmentation index is out of bound!");
-	length_type start { m_aug_sep[t_index] + 1 }, end;
-	if (m_aug_sep.size() - 1 == t_index) end = m_columns - 1;
-	else end = m_aug_sep[t_index + 1];
-	if (t_matrix) {
-		*t_matrix = Matrix(*this, 0, start, m_rows - 1, end);
-	}
-	*this = Matrix(*this, 0, 0, m_rows - 1, start - 1);
-	if (m_determinant) {
-		delete m_determinant;
-		m_determinant = nullptr;
-	}
+	if (t_matrix && t_matrix != this)
+		*t_matrix = static_cast<const Matrix&>(*this).section(t_index + 1);	// reuses the buffer of t_matrix when it has the same dimensions
+	length_type columns = m_aug_sep[t_index] + 1, stride = m_alignedStride(columns);
+	if (m_shared()) {	// the columns kept are copied to a buffer of its own
+		value_type* old_data = m_data;
+		length_type old_stride = m_stride;
+		std::size_t old_capacity = m_capacity;
+		m_allocate(m_rows, columns);
+		for (length_type i = 0; i < m_rows; i++)
+			std::memcpy(m_row(i), old_data + std::size_t(i) * old_stride, columns * sizeof(value_type));
+		m_freeBuffer(old_data, old_capacity);
+	}
+	else for (length_type i = 0; i < m_rows; i++) {	// the columns kept are moved to the front of their rows, in place
+		value_type* row = m_data + std::size_t(i) * stride;
+		if (i > 0) std::memmove(row, m_row(i), columns * sizeof(value_type));
+		std::fill(row + columns, row + stride, value_type(0));	// padding stays zero
+	}
+	m_columns = columns;
+	m_stride = stride;
+	m_aug_sep.resize(t_index);
+	m_dropDeterminant();
 }
 
 void Matrix::addSeperator (length_type t_index) {
@@ -379,31 +634,17 @@ bool Matrix::removeSeperators () {
 
 void Matrix::setCell (length_type t_row, length_type t_column, value_type t_value) {
 	if (t_row >= m_rows || t_column >= m_columns) throw ("Indices are out of bound!");
-	m_matrix[t_row][t_column] = t_value;
-	if (m_determinant) {
-		delete m_determinant;
-		m_determinant = nullptr;
-	}
+	m_unshare();
+	m_row(t_row)[t_column] = t_value;
+	m_dropDeterminant();
 }
 
 void Matrix::calculateDeterminant () {
 	if (m_rows != m_columns) {
-		if (m_determinant) {
-			delete m_determinant;
-			m_determinant = nullptr;
-		}
+		m_dropDeterminant();
 		return;
 	}
-
-	if (!m_determinant) m_determinant = new value_type;
-
-	if (m_rows == 1) { *m_determinant = m_matrix[0][0]; return; }
-	if (m_rows == 2) { *m_determinant = (m_matrix[0][0] * m_matrix[1][1]) - (m_matrix[0][1] * m_matrix[1][0]); return; }
-
-	// calculating determinant of nxn matrix for n >= 3
-	Matrix echelon_formed = *this;
-	echelon_formed.echelon();
-	*m_determinant = echelon_formed.getDeterminant();
+	m_setDeterminant(m_computeDeterminant());
 }
 
 Matrix::value_type Matrix::getCell (length_type t_row, length_type t_column) const {
@@ -413,7 +654,7 @@ Matrix::value_type Matrix::getCell (length_type t_row, length_type t_column) con
 		std::cerr << "Returned zero.\n";
 		return value_type{0};
 	}
-	return m_matrix[t_row][t_column];
+	return m_row(t_row)[t_column];
 }
 
 Matrix::length_type Matrix::getRows () const {
@@ -425,12 +666,25 @@ Matrix::length_type Matrix::getColumns () const {
 }
 
 Matrix::value_type Matrix::getDeterminant () const {
-	if (!m_determinant) {
-		Matrix& ref = const_cast<Matrix&>(*this);
-		ref.calculateDeterminant();
-		if (!m_determinant) throw("Matrix has no determinant!");
+	if (m_hasDeterminant()) return m_determinant;
+	if (m_rows != m_columns) throw("Matrix has no determinant!");
+	unsigned char state = m_unknown;
+	if (m_determinant_state.compare_exchange_strong(state, m_computing, std::memory_order_acquire)) {
+		value_type determinant;
+		try { determinant = m_computeDeterminant(); }
+		catch (...) {
+			m_determinant_state.store(m_unknown, std::memory_order_release);
+			throw;
+		}
+		m_determinant = determinant;
+		m_determinant_state.store(m_known, std::memory_order_release);	// publishes m_determinant
+		return determinant;
 	}
-	return *m_determinant;
+	// another thread is computing it; queued pool work is run meanwhile, it may be that thread's
+	detail::ThreadPool& pool = detail::ThreadPool::instance();
+	while (m_determinant_state.load(std::memory_order_acquire) == m_computing)
+		if (!pool.runPending()) std::this_thread::yield();
+	return getDeterminant();	// known now, or computing it failed there and is tried again here
 }
 
 Matrix& Matrix::add (const Matrix& t_matrix) {
@@ -438,82 +692,152 @@ Matrix& Matrix::add (const Matrix& t_matrix) {
 	return *this;
 }
 
+Matrix& Matrix::add (const ConstMatrixView& t_view) {
+	*this = *this + t_view;
+	return *this;
+}
+
 Matrix& Matrix::multiply (const Matrix& t_matrix) {
-	*this = *this * t_matrix;
+	bool known = m_hasDeterminant() && t_matrix.m_hasDeterminant();
+	value_type determinant = known ? m_determinant * t_matrix.m_determinant : value_type(0);
+	multiply(t_matrix.view());
+	if (known) {
+		m_setDeterminant(determinant);
+	}
+	return *this;
+}
+
+Matrix& Matrix::multiply (const ConstMatrixView& t_view) {
+	if (m_columns != t_view.getRows()) throw ("Columns of first matrix not equal to rows of second one!");
+	M_INSTRUMENT(multiply, 2.0 * m_rows * m_columns * t_view.getColumns(),
+			sizeof(value_type) * (double(m_rows) * m_columns + double(m_columns) * t_view.getColumns() + double(m_rows) * t_view.getColumns()));
+	length_type columns = t_view.getColumns(), stride = m_alignedStride(columns);
+	std::size_t count = std::size_t(m_rows) * stride;
+	// buffers of other resources stay with them, shared ones with their other holders
+	if (!m_resource->is_equal(*std::pmr::new_delete_resource()) || m_shared()) {
+		value_type* data = m_allocateBuffer(count);
+		denseProduct(m_rows, columns, m_columns, m_data, m_stride, t_view.data(), t_view.stride(), data, stride,
+				m_product_type);
+		m_release();
+		m_data = data;
+		m_capacity = count;
+	}
+	else {
+		ProductScratch& scratch = productScratch();
+		if (scratch.capacity < count) {
+			m_freeBuffer(scratch.data, scratch.capacity);
+			scratch.data = nullptr;
+			scratch.capacity = 0;
+			scratch.data = m_allocateBuffer(count);
+			scratch.capacity = count;
+		}
+		denseProduct(m_rows, columns, m_columns, m_data, m_stride, t_view.data(), t_view.stride(), scratch.data, stride,
+				m_product_type);
+		std::swap(m_data, scratch.data);
+		std::swap(m_capacity, scratch.capacity);
+		header(m_data)->leaked.store(false, std::memory_order_relaxed);		// no view of the matrix looks at it yet
+	}
+	m_columns = columns;
+	m_stride = stride;
+	m_dropDeterminant();
+	if (!m_aug_sep.empty()) m_aug_sep.clear();
+	return *this;
+}
+
+Matrix& Matrix::operator*= (value_type t_constant) {
+	*this = *this * t_constant;
 	return *this;
 }
 
+Matrix& Matrix::operator*= (const Matrix& t_matrix) {
+	return multiply(t_matrix);
+}
+
+Matrix& Matrix::operator*= (const ConstMatrixView& t_view) {
+	return multiply(t_view);
+}
+
 Matrix& Matrix::operator= (const Matrix& t_matrix) {
 	if (this == &t_matrix) return *this;
 	// clean up
-	if (m_determinant) {
-		delete m_determinant;
-		m_determinant = nullptr;
-	}
+	m_dropDeterminant();
 	if (!m_aug_sep.empty()) m_aug_sep.clear();
 	
 	// create
-	m_rows = t_matrix.m_rows; m_columns = t_matrix.m_columns;
-	m_matrix.resize(m_rows, row_type{});
-	for (length_type i = 0; i < m_rows; i++)
-		m_matrix[i] = t_matrix.m_matrix[i];
-	if (t_matrix.m_determinant) {
-		m_determinant = new value_type;
-		*m_determinant = *t_matrix.m_determinant;
+	std::size_t count = std::size_t(t_matrix.m_rows) * t_matrix.m_stride;
+	if (m_shareable(t_matrix)) {
+		value_type* old_data = m_data;
+		std::size_t old_capacity = m_capacity;
+		m_share(t_matrix);
+		m_freeBuffer(old_data, old_capacity);
+	}
+	else {
+		M_INSTRUMENT(copy, 0, 2.0 * sizeof(value_type) * double(count));
+		if (m_capacity < count || m_shared()) {	// reuses the buffer when it is large enough and its own
+			m_release();
+			m_data = m_allocateBuffer(count);
+			m_capacity = count;
+		}
+		std::memcpy(m_data, t_matrix.m_data, count * sizeof(value_type));
 	}
+	m_rows = t_matrix.m_rows; m_columns = t_matrix.m_columns; m_stride = t_matrix.m_stride;
+	if (t_matrix.m_hasDeterminant()) m_setDeterminant(t_matrix.m_determinant);
 	if (!t_matrix.m_aug_sep.empty()) m_aug_sep = t_matrix.m_aug_sep;
 	return *this;
 }
 
-Matrix Matrix::operator- () const {
-	Matrix res(m_rows, m_columns);
-	for (length_type i = 0; i < m_rows; i++)
-		for (length_type j = 0; j < m_columns; j++)
-			res.m_matrix[i][j] = - m_matrix[i][j];
-	return res;
-}
-
-Matrix Matrix::operator+ (const Matrix& t_matrix) const {
-	if (m_rows != t_matrix.m_rows || m_columns != t_matrix.m_columns) throw ("Matrices couldn't be added!");
-	Matrix res(m_rows, m_columns);
-	for (length_type i = 0; i < m_rows; i++)
-		for (length_type j = 0; j < m_columns; j++)
-			res.m_matrix[i][j] = m_matrix[i][j] + t_matrix.m_matrix[i][j];
-	if (m_determinant)
-		delete res.m_determinant;
-	return res;
-}
-
-Matrix Matrix::operator- (const Matrix& t_matrix) const {
-	return *this + (-t_matrix);
+Matrix& Matrix::operator= (Matrix&& t_matrix) noexcept {
+	if (this == &t_matrix) return *this;
+	m_release();
+	m_dropDeterminant();
+	m_resource = t_matrix.m_resource;
+	m_data = t_matrix.m_data;
+	m_rows = t_matrix.m_rows; m_columns = t_matrix.m_columns; m_stride = t_matrix.m_stride;
+	m_capacity = t_matrix.m_capacity;
+	m_aug_sep = std::move(t_matrix.m_aug_sep);
+	if (t_matrix.m_hasDeterminant()) m_setDeterminant(t_matrix.m_determinant);
+	t_matrix.m_data = nullptr;
+	t_matrix.m_dropDeterminant();
+	t_matrix.m_rows = t_matrix.m_columns = t_matrix.m_stride = 0;
+	t_matrix.m_capacity = 0;
+	return *this;
 }
 
 Matrix Matrix::operator* (const Matrix& t_matrix) const {
 	if (m_columns != t_matrix.m_rows) throw ("Columns of first matrix not equal to rows of second one!");
-	length_type common = m_columns;
+	M_INSTRUMENT(multiply, 2.0 * m_rows * m_columns * t_matrix.m_columns,
+			sizeof(value_type) * (double(m_rows) * m_columns + double(m_columns) * t_matrix.m_columns + double(m_rows) * t_matrix.m_columns));
 	Matrix res(m_rows, t_matrix.m_columns);
-	for (length_type i = 0; i < res.m_rows; i++)
-		for (length_type j = 0; j < res.m_columns; j++) {
-			res.m_matrix[i][j] = 0;
-			for (length_type k = 0; k < common; k++)
-				res.m_matrix[i][j] += m_matrix[i][k] * t_matrix.m_matrix[k][j];
-		}
-	if (t_matrix.m_determinant && m_determinant) {
-		res.m_determinant = new value_type;
-		*res.m_determinant = *t_matrix.m_determinant * *m_determinant;
+	denseProduct(m_rows, t_matrix.m_columns, m_columns, m_data, m_stride, t_matrix.m_data, t_matrix.m_stride,
+			res.m_data, res.m_stride, m_product_type);
+	if (res.m_hasDeterminant()) {
+		if (t_matrix.m_hasDeterminant() && m_hasDeterminant()) res.m_determinant = t_matrix.m_determinant * m_determinant;
+		else res.m_dropDeterminant();
 	}
 	return res;
 }
 
-Matrix Matrix::operator* (const value_type t_constant) const {
-	Matrix res(*this);
-	for (auto& row_extern : res.m_matrix)
-		for (auto& cell : row_extern)
-			cell *= t_constant;
-	if (res.m_determinant) {
-		res.m_determinant = new value_type;
-		*res.m_determinant = t_constant * (*m_determinant) * value_type(m_rows);
-	}
+Matrix Matrix::operator* (const ConstMatrixView& t_view) const {
+	return detail::product(detail::productOperand(view()), detail::productOperand(t_view));
+}
+
+Matrix Matrix::operator* (const TransposedView& t_view) const {
+	return detail::product(detail::productOperand(view()), detail::productOperand(t_view));
+}
+
+Matrix detail::product (const ProductOperand& t_left, const ProductOperand& t_right, Matrix::product_type t_type) {
+	if (t_left.columns != t_right.rows) throw ("Columns of first matrix not equal to rows of second one!");
+	M_INSTRUMENT(multiply, 2.0 * t_left.rows * t_left.columns * t_right.columns,
+			sizeof(value_type) * (double(t_left.rows) * t_left.columns + double(t_right.rows) * t_right.columns
+			+ double(t_left.rows) * t_right.columns));
+	Matrix res(t_left.rows, t_right.columns);
+	value_type* out = detail::writableView(res).data();	// forgets the (zero) determinant a new square matrix starts with
+	if (t_left.column_stride == 1 && t_right.column_stride == 1)
+		denseProduct(t_left.rows, t_right.columns, t_left.columns, t_left.data, t_left.row_stride, t_right.data,
+				t_right.row_stride, out, res.stride(), t_type);
+	else
+		detail::gemm(t_left.rows, t_right.columns, t_left.columns, value_type(1), t_left.data, t_left.row_stride,
+				t_left.column_stride, t_right.data, t_right.row_stride, t_right.column_stride, value_type(0), out, res.stride());
 	return res;
 }
 
@@ -521,18 +845,167 @@ void Matrix::setPrecision (int t_precision) {
 	m_precision = t_precision;
 }
 
+int Matrix::getPrecision () {
+	return m_precision;
+}
+
+void Matrix::setThreads (unsigned t_threads) {
+	detail::ThreadPool::instance().resize(t_threads);
+}
+
+unsigned Matrix::getThreads () {
+	return detail::ThreadPool::instance().size();
+}
+
+void Matrix::setProductType (product_type t_type) {
+	m_product_type = t_type;
+}
+
+Matrix::product_type Matrix::getProductType () {
+	return m_product_type;
+}
+
+void Matrix::setStrassenCrossover (length_type t_crossover) {
+	if (t_crossover < 32) throw ("Strassen crossover must be at least 32!");
+	m_strassen_crossover = t_crossover;
+}
+
+Matrix::length_type Matrix::getStrassenCrossover () {
+	return m_strassen_crossover;
+}
+
+std::pmr::memory_resource* Matrix::getResource () const {
+	return m_resource;
+}
+
+Matrix::length_type Matrix::getMatricesCount () {
+	return m_matrices_count;
+}
+
+Matrix::value_type* Matrix::data () {
+	m_leak();
+	m_dropDeterminant();	// cells may be written through the pointer
+	return m_data;
+}
+
+const Matrix::value_type* Matrix::data () const {
+	return m_data;
+}
+
+Matrix::length_type Matrix::stride () const {
+	return m_stride;
+}
+
 Matrix::~Matrix () {
 	m_matrices_count--;
-	if (m_determinant) {
-		delete m_determinant;
-		m_determinant = nullptr;
-	}
+	m_release();
 }
 
 void Matrix::m_defaultConstruct () {
 	m_rows = m_columns = 1;
-	m_matrix.resize(1, row_type{value_type{0}});
-	if (!m_determinant) m_determinant = new value_type;
-	*m_determinant = value_type{1};
+	m_release();
+	m_allocate(1, 1);
+	m_setDeterminant(value_type{1});
 	if (!m_aug_sep.empty()) m_aug_sep.clear();
 }
+
+void Matrix::m_allocate (length_type t_rows, length_type t_columns, bool t_zero) {
+	m_stride = m_alignedStride(t_columns);
+	m_capacity = std::size_t(t_rows) * m_stride;
+	m_data = m_allocateBuffer(m_capacity);
+	if (t_zero) std::fill_n(m_data, m_capacity, value_type(0));
+}
+
+void Matrix::m_release () {
+	m_freeBuffer(m_data, m_capacity);
+	m_data = nullptr;
+	m_capacity = 0;
+}
+
+bool Matrix::m_shared () const {
+	return m_data && header(m_data)->references.load(std::memory_order_acquire) != 1;
+}
+
+void Matrix::m_unshare (bool t_keep) {
+	if (!m_shared()) return;
+	std::size_t count = std::size_t(m_rows) * m_stride;
+	value_type* data = m_allocateBuffer(count);
+	if (t_keep) {
+		M_INSTRUMENT(copy, 0, 2.0 * sizeof(value_type) * double(count));
+		std::memcpy(data, m_data, count * sizeof(value_type));
+	}
+	else for (length_type i = 0; i < m_rows && m_stride != m_columns; i++)	// padding stays zero
+		std::fill(data + std::size_t(i) * m_stride + m_columns, data + std::size_t(i + 1) * m_stride, value_type(0));
+	m_freeBuffer(m_data, m_capacity);
+	m_data = data;
+	m_capacity = count;
+}
+
+void Matrix::m_leak () {
+	m_unshare();
+	if (m_data) header(m_data)->leaked.store(true, std::memory_order_relaxed);
+}
+
+MatrixView detail::writableView (Matrix& t_matrix) {
+	t_matrix.m_unshare();
+	t_matrix.m_dropDeterminant();
+	return MatrixView(t_matrix.m_data, t_matrix.m_rows, t_matrix.m_columns, t_matrix.m_stride);
+}
+
+bool Matrix::m_shareable (const Matrix& t_matrix) const {
+	return m_resource->is_equal(*t_matrix.m_resource)
+		&& !(t_matrix.m_data && header(t_matrix.m_data)->leaked.load(std::memory_order_relaxed));
+}
+
+void Matrix::m_share (const Matrix& t_matrix) {
+	if (t_matrix.m_data) header(t_matrix.m_data)->references.fetch_add(1, std::memory_order_relaxed);
+	m_data = t_matrix.m_data;
+	m_capacity = t_matrix.m_capacity;
+}
+
+void Matrix::m_dropDeterminant () {
+	m_determinant_state.store(m_unknown, std::memory_order_relaxed);
+}
+
+void Matrix::m_setDeterminant (value_type t_determinant) {
+	m_determinant = t_determinant;
+	m_determinant_state.store(m_known, std::memory_order_release);
+}
+
+Matrix::value_type Matrix::m_computeDeterminant () const {
+	M_INSTRUMENT(determinant, 2.0 / 3 * m_rows * m_rows * m_rows, sizeof(value_type) * m_rows * m_rows);
+	if (m_rows == 1) return m_data[0];
+	if (m_rows == 2) return (m_row(0)[0] * m_row(1)[1]) - (m_row(0)[1] * m_row(1)[0]);
+	// calculating determinant of nxn matrix for n >= 3
+	return LU(*this).determinant();
+}
+
+void Matrix::m_sectionBounds (length_type t_index, length_type& t_first, length_type& t_last) const {
+	if (t_index > m_aug_sep.size()) throw ("Augmentation index is out of bound!");
+	t_first = t_index == 0 ? 0 : m_aug_sep[t_index - 1] + 1;
+	t_last = t_index == m_aug_sep.size() ? m_columns - 1 : m_aug_sep[t_index];
+}
+
+void detail::forRowBlocks (uint32_t t_rows, uint32_t t_columns, const std::function<void (uint32_t, uint32_t)>& t_body) {
+	::forRowBlocks(t_rows, t_columns, t_body);
+}
+
+Matrix::length_type Matrix::m_alignedStride (length_type t_columns) {
+	// rows narrower than one alignment block are packed, wider ones are padded to start on a block
+	constexpr length_type block = length_type(alignment / sizeof(value_type));
+	if (t_columns < block) return t_columns;
+	return (t_columns + block - 1) / block * block;
+}
+
+Matrix::value_type* Matrix::m_allocateBuffer (std::size_t t_count) const {
+	M_INSTRUMENT_ALLOCATION(header_bytes + t_count * sizeof(value_type));
+	char* block = static_cast<char*>(m_resource->allocate(header_bytes + t_count * sizeof(value_type), alignment));
+	new (block) BufferHeader(1);
+	return reinterpret_cast<value_type*>(block + header_bytes);
+}
+
+void Matrix::m_freeBuffer (value_type* t_buffer, std::size_t t_count) const {
+	if (!t_buffer || header(t_buffer)->references.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+	header(t_buffer)->~BufferHeader();
+	m_resource->deallocate(reinterpret_cast<char*>(t_buffer) - header_bytes, header_bytes + t_count * sizeof(value_type), alignment);
+}
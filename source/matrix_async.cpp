@@ -0,0 +1,98 @@
+#include <chrono>
+#include "matrix_async.h"
+#include "lu.h"
+#include "thread_pool.h"
+
+using namespace m;
+using namespace m::async;
+
+void async::detail::schedule (std::function<void ()> t_task) {
+	m::detail::ThreadPool::instance().submit(std::move(t_task));
+}
+
+std::function<void ()> async::detail::countdown (std::size_t t_count, std::function<void ()> t_start) {
+	if (t_count == 0) { t_start(); return [] {}; }
+	auto remaining = std::make_shared<std::atomic<std::size_t>>(t_count);
+	return [remaining, t_start] {
+		if (remaining->fetch_sub(1, std::memory_order_acq_rel) == 1) t_start();
+	};
+}
+
+bool async::detail::StateBase::ready () const {
+	return m_ready.load(std::memory_order_acquire);
+}
+
+void async::detail::StateBase::wait () const {
+	m::detail::ThreadPool& pool = m::detail::ThreadPool::instance();
+	while (!ready()) {
+		if (pool.runPending()) continue;
+		// nothing queued: the task is running elsewhere, or is to be queued once its operands are ready
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait_for(lock, std::chrono::milliseconds(1), [this] { return ready(); });
+	}
+}
+
+void async::detail::StateBase::onReady (std::function<void ()> t_continuation) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!ready()) { m_continuations.push_back(std::move(t_continuation)); return; }
+	}
+	t_continuation();
+}
+
+void async::detail::StateBase::fail (std::exception_ptr t_error) {
+	m_error = t_error;
+	m_complete();
+}
+
+void async::detail::StateBase::rethrow () const {
+	if (m_error) std::rethrow_exception(m_error);
+}
+
+void async::detail::StateBase::m_complete () {
+	std::vector<std::function<void ()>> continuations;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_ready.store(true, std::memory_order_release);		// publishes the result (or m_error)
+		continuations.swap(m_continuations);
+	}
+	m_done.notify_all();
+	for (std::function<void ()>& continuation : continuations)
+		continuation();
+}
+
+Future<Matrix> async::multiply (const Future<Matrix>& t_left, const Future<Matrix>& t_right) {
+	return run([] (const Matrix& t_a, const Matrix& t_b) { return t_a * t_b; }, t_left, t_right);
+}
+
+Future<Matrix> async::add (const Future<Matrix>& t_left, const Future<Matrix>& t_right) {
+	return run([] (const Matrix& t_a, const Matrix& t_b) { return Matrix(t_a + t_b); }, t_left, t_right);
+}
+
+Future<Matrix> async::subtract (const Future<Matrix>& t_left, const Future<Matrix>& t_right) {
+	return run([] (const Matrix& t_a, const Matrix& t_b) { return Matrix(t_a - t_b); }, t_left, t_right);
+}
+
+Future<Matrix> async::scale (const Future<Matrix>& t_matrix, Matrix::value_type t_constant) {
+	return run([t_constant] (const Matrix& t_a) { return Matrix(t_a * t_constant); }, t_matrix);
+}
+
+Future<Matrix> async::transpose (const Future<Matrix>& t_matrix) {
+	return run([] (const Matrix& t_a) { return Matrix(t_a.transposed()); }, t_matrix);
+}
+
+Future<Matrix> async::invert (const Future<Matrix>& t_matrix) {
+	return run([] (const Matrix& t_a) {
+		Matrix res(t_a);
+		res.invert();
+		return res;
+	}, t_matrix);
+}
+
+Future<Matrix::value_type> async::determinant (const Future<Matrix>& t_matrix) {
+	return run([] (const Matrix& t_a) { return t_a.getDeterminant(); }, t_matrix);
+}
+
+Future<Matrix> async::solve (const Future<Matrix>& t_a, const Future<Matrix>& t_b) {
+	return run([] (const Matrix& t_a, const Matrix& t_b) { return m::solve(t_a, t_b); }, t_a, t_b);
+}
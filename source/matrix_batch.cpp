@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+#include "matrix_batch.h"
+#include "thread_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define M_BATCH_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define M_BATCH_CLONES
+#endif
+
+using namespace m;
+
+namespace {
+	using value_type = MatrixBatch::value_type;
+	using length_type = MatrixBatch::length_type;
+
+	constexpr std::size_t WIDTH = 8;								// matrices handled by one vector
+	constexpr std::size_t BLOCK = Matrix::alignment / sizeof(value_type);
+	constexpr std::size_t CELLS = std::size_t(MatrixBatch::max_length) * MatrixBatch::max_length;
+	constexpr std::size_t PARALLEL_WORK = 1 << 15;				// smaller batches stay on the calling thread
+
+	/* one cell of WIDTH matrices. Only +, -, *, / and comparisons are used, each rounded exactly as the
+	  scalar operation Matrix does (no multiply-add is fused, the avx2 clones are built without fma) */
+	typedef value_type lanes_type __attribute__((vector_size(WIDTH * sizeof(value_type))));
+	typedef int32_t mask_type __attribute__((vector_size(WIDTH * sizeof(int32_t))));
+
+	// calls t_body(first, last) over [0, t_count) split across the pool when t_work cells are touched
+	template <class Body>
+	void split (std::size_t t_count, std::size_t t_work, Body&& t_body) {
+		detail::ThreadPool& pool = detail::ThreadPool::instance();
+		if (pool.size() <= 1 || t_work < PARALLEL_WORK || t_count < 2) { t_body(std::size_t(0), t_count); return; }
+		std::size_t grain = std::max<std::size_t>(1, t_count / (std::size_t(pool.size()) * 4));
+		pool.parallelFor(0, t_count, grain, t_body);
+	}
+
+	// copies t_cells cells of the matrices starting at t_lane into t_out (cells are t_lanes apart in t_data)
+	inline __attribute__((always_inline)) void load (const value_type* t_data, std::size_t t_lanes, std::size_t t_lane,
+			std::size_t t_cells, lanes_type* t_out) {
+		for (std::size_t c = 0; c < t_cells; c++)
+			std::memcpy(&t_out[c], t_data + c * t_lanes + t_lane, sizeof(lanes_type));
+	}
+
+	inline __attribute__((always_inline)) void store (const lanes_type* t_cells, std::size_t t_count, value_type* t_data,
+			std::size_t t_lanes, std::size_t t_lane) {
+		for (std::size_t c = 0; c < t_count; c++)
+			std::memcpy(t_data + c * t_lanes + t_lane, &t_cells[c], sizeof(lanes_type));
+	}
+
+	/* LU::m_factor for one panel (n <= 64), per lane: lanes differ in their pivots, so rows are swapped
+	  by blending, and lanes whose column is all zero skip the elimination as LU does */
+	inline __attribute__((always_inline)) void factor (lanes_type* t_a, length_type t_n, mask_type* t_pivots,
+			mask_type& t_negate, mask_type& t_singular) {
+		t_negate = mask_type {};
+		t_singular = mask_type {};
+		for (length_type j = 0; j < t_n; j++) {
+			mask_type pivot = mask_type {} + int32_t(j);
+			lanes_type largest = lanes_type(mask_type(t_a[j * t_n + j]) & INT32_MAX);		// fabs
+			for (length_type i = j + 1; i < t_n; i++) {
+				lanes_type value = lanes_type(mask_type(t_a[i * t_n + j]) & INT32_MAX);
+				mask_type larger = value > largest;
+				largest = larger ? value : largest;
+				pivot = larger ? mask_type {} + int32_t(i) : pivot;
+			}
+			t_pivots[j] = pivot;
+			mask_type zero = largest == lanes_type {};
+			t_singular |= zero;
+			t_negate ^= pivot != int32_t(j);
+			for (length_type r = j + 1; r < t_n; r++) {
+				mask_type swapped = pivot == int32_t(r);
+				for (length_type c = 0; c < t_n; c++) {
+					lanes_type top = t_a[j * t_n + c];
+					t_a[j * t_n + c] = swapped ? t_a[r * t_n + c] : top;
+					t_a[r * t_n + c] = swapped ? top : t_a[r * t_n + c];
+				}
+			}
+			const lanes_type* pivot_row = t_a + j * t_n;
+			for (length_type i = j + 1; i < t_n; i++) {
+				lanes_type* row = t_a + i * t_n;
+				lanes_type multiple = row[j] / pivot_row[j];
+				row[j] = zero ? row[j] : multiple;
+				for (length_type c = j + 1; c < t_n; c++)
+					row[c] = zero ? row[c] : row[c] - multiple * pivot_row[c];
+			}
+		}
+	}
+
+	// LU::m_solveInPlace per lane on the t_n x t_columns right-hand sides t_b
+	inline __attribute__((always_inline)) void solveFactored (const lanes_type* t_a, length_type t_n,
+			const mask_type* t_pivots, lanes_type* t_b, length_type t_columns) {
+		for (length_type i = 0; i < t_n; i++)
+			for (length_type r = i + 1; r < t_n; r++) {
+				mask_type swapped = t_pivots[i] == int32_t(r);
+				for (length_type c = 0; c < t_columns; c++) {
+					lanes_type top = t_b[i * t_columns + c];
+					t_b[i * t_columns + c] = swapped ? t_b[r * t_columns + c] : top;
+					t_b[r * t_columns + c] = swapped ? top : t_b[r * t_columns + c];
+				}
+			}
+		for (length_type i = 1; i < t_n; i++) {		// L * y = P * b
+			lanes_type* row = t_b + i * t_columns;
+			for (length_type k = 0; k < i; k++) {
+				lanes_type multiple = t_a[i * t_n + k];
+				mask_type skip = multiple == lanes_type {};
+				const lanes_type* source = t_b + k * t_columns;
+				for (length_type c = 0; c < t_columns; c++)
+					row[c] = skip ? row[c] : row[c] - multiple * source[c];
+			}
+		}
+		for (length_type i = t_n; i-- > 0; ) {		// U * x = y
+			lanes_type* row = t_b + i * t_columns;
+			for (length_type k = i + 1; k < t_n; k++) {
+				lanes_type multiple = t_a[i * t_n + k];
+				mask_type skip = multiple == lanes_type {};
+				const lanes_type* source = t_b + k * t_columns;
+				for (length_type c = 0; c < t_columns; c++)
+					row[c] = skip ? row[c] : row[c] - multiple * source[c];
+			}
+			lanes_type diagonal = t_a[i * t_n + i];
+			for (length_type c = 0; c < t_columns; c++)
+				row[c] = row[c] / diagonal;
+		}
+	}
+
+	// the kernels below walk groups [t_first, t_last) of WIDTH matrices; cells are t_lanes apart
+
+	// same dot products as the small path of detail::gemm, summed from zero in the same order
+	M_BATCH_CLONES
+	void multiplyGroups (const value_type* t_a, const value_type* t_b, value_type* t_c, std::size_t t_lanes,
+			length_type t_m, length_type t_k, length_type t_n, std::size_t t_first, std::size_t t_last) {
+		lanes_type a[CELLS], b[CELLS];
+		for (std::size_t g = t_first; g < t_last; g++) {
+			std::size_t lane = g * WIDTH;
+			load(t_a, t_lanes, lane, std::size_t(t_m) * t_k, a);
+			load(t_b, t_lanes, lane, std::size_t(t_k) * t_n, b);
+			for (length_type i = 0; i < t_m; i++)
+				for (length_type j = 0; j < t_n; j++) {
+					lanes_type sum = lanes_type {};
+					for (length_type p = 0; p < t_k; p++)
+						sum += a[i * t_k + p] * b[p * t_n + j];
+					store(&sum, 1, t_c + (std::size_t(i) * t_n + j) * t_lanes, 0, lane);
+				}
+		}
+	}
+
+	// Matrix::calculateDeterminant: closed forms up to 2 x 2, the product of the LU diagonal above
+	M_BATCH_CLONES
+	void determinantGroups (const value_type* t_a, value_type* t_det, std::size_t t_lanes, length_type t_n,
+			std::size_t t_first, std::size_t t_last) {
+		lanes_type a[CELLS];
+		mask_type pivots[MatrixBatch::max_length], negate, singular;
+		for (std::size_t g = t_first; g < t_last; g++) {
+			std::size_t lane = g * WIDTH;
+			load(t_a, t_lanes, lane, std::size_t(t_n) * t_n, a);
+			lanes_type det;
+			if (t_n == 1) det = a[0];
+			else if (t_n == 2) det = (a[0] * a[3]) - (a[1] * a[2]);
+			else {
+				factor(a, t_n, pivots, negate, singular);
+				det = lanes_type {} + value_type(1);
+				for (length_type i = 0; i < t_n; i++)
+					det *= a[i * t_n + i];
+				det = negate ? -det : det;
+			}
+			store(&det, 1, t_det, 0, lane);
+		}
+	}
+
+	// LU(A).solve(B), or LU(A).inverse() when t_b is null; t_x may be t_a or t_b
+	M_BATCH_CLONES
+	void solveGroups (const value_type* t_a, const value_type* t_b, value_type* t_x, char* t_singular,
+			std::size_t t_lanes, length_type t_n, length_type t_columns, std::size_t t_first, std::size_t t_last) {
+		lanes_type a[CELLS], x[CELLS];
+		mask_type pivots[MatrixBatch::max_length], negate, singular;
+		for (std::size_t g = t_first; g < t_last; g++) {
+			std::size_t lane = g * WIDTH;
+			load(t_a, t_lanes, lane, std::size_t(t_n) * t_n, a);
+			if (t_b) load(t_b, t_lanes, lane, std::size_t(t_n) * t_columns, x);
+			else for (length_type i = 0; i < t_n; i++)
+				for (length_type j = 0; j < t_n; j++)
+					x[i * t_n + j] = lanes_type {} + value_type(i == j ? 1 : 0);
+			factor(a, t_n, pivots, negate, singular);
+			solveFactored(a, t_n, pivots, x, t_columns);
+			store(x, std::size_t(t_n) * t_columns, t_x, t_lanes, lane);
+			for (std::size_t l = 0; l < WIDTH; l++)
+				t_singular[lane + l] = singular[l] != 0;
+		}
+	}
+}
+
+MatrixBatch::MatrixBatch (std::size_t t_count, length_type t_rows, length_type t_columns)
+		: m_count(t_count), m_lanes((t_count + BLOCK - 1) / BLOCK * BLOCK), m_rows(t_rows), m_columns(t_columns), m_data(nullptr) {
+	if (t_count == 0) throw ("Batch must hold at least one matrix!");
+	if (t_rows == 0 || t_columns == 0) throw ("Number of rows and columns must be positive!");
+	if (t_rows > max_length || t_columns > max_length) throw ("Batched matrices can't exceed 16 rows or columns!");
+	std::size_t count = m_lanes * m_rows * m_columns;
+	m_data = static_cast<value_type*>(::operator new(count * sizeof(value_type), std::align_val_t(Matrix::alignment)));
+	std::fill_n(m_data, count, value_type(0));
+}
+
+MatrixBatch::MatrixBatch (const std::vector<Matrix>& t_matrices)
+		: MatrixBatch(t_matrices.size(), t_matrices.empty() ? 1 : t_matrices[0].getRows(),
+				t_matrices.empty() ? 1 : t_matrices[0].getColumns()) {
+	for (std::size_t k = 0; k < m_count; k++)
+		set(k, t_matrices[k]);
+}
+
+MatrixBatch::MatrixBatch (const MatrixBatch& t_batch) : MatrixBatch(t_batch.m_count, t_batch.m_rows, t_batch.m_columns) {
+	std::memcpy(m_data, t_batch.m_data, m_lanes * m_rows * m_columns * sizeof(value_type));
+}
+
+MatrixBatch::MatrixBatch (MatrixBatch&& t_batch) noexcept
+		: m_count(t_batch.m_count), m_lanes(t_batch.m_lanes), m_rows(t_batch.m_rows), m_columns(t_batch.m_columns),
+		m_data(std::exchange(t_batch.m_data, nullptr)) {
+	t_batch.m_count = t_batch.m_lanes = 0;
+	t_batch.m_rows = t_batch.m_columns = 0;
+}
+
+MatrixBatch& MatrixBatch::operator= (const MatrixBatch& t_batch) {
+	if (this != &t_batch) *this = MatrixBatch(t_batch);
+	return *this;
+}
+
+MatrixBatch& MatrixBatch::operator= (MatrixBatch&& t_batch) noexcept {
+	std::swap(m_count, t_batch.m_count);
+	std::swap(m_lanes, t_batch.m_lanes);
+	std::swap(m_rows, t_batch.m_rows);
+	std::swap(m_columns, t_batch.m_columns);
+	std::swap(m_data, t_batch.m_data);
+	return *this;
+}
+
+MatrixBatch::~MatrixBatch () {
+	if (m_data) ::operator delete(m_data, std::align_val_t(Matrix::alignment));
+}
+
+std::size_t MatrixBatch::size () const {
+	return m_count;
+}
+
+MatrixBatch::length_type MatrixBatch::getRows () const {
+	return m_rows;
+}
+
+MatrixBatch::length_type MatrixBatch::getColumns () const {
+	return m_columns;
+}
+
+MatrixBatch::value_type MatrixBatch::getCell (std::size_t t_index, length_type t_row, length_type t_column) const {
+	return m_data[m_cell(t_index, t_row, t_column)];
+}
+
+void MatrixBatch::setCell (std::size_t t_index, length_type t_row, length_type t_column, value_type t_value) {
+	m_data[m_cell(t_index, t_row, t_column)] = t_value;
+}
+
+Matrix MatrixBatch::get (std::size_t t_index) const {
+	if (t_index >= m_count) throw ("Indices are out of bound!");
+	Matrix res(m_rows, m_columns);
+	value_type* data = detail::writableView(res).data();
+	for (length_type i = 0; i < m_rows; i++)
+		for (length_type j = 0; j < m_columns; j++)
+			data[i * res.stride() + j] = m_data[(std::size_t(i) * m_columns + j) * m_lanes + t_index];
+	return res;
+}
+
+void MatrixBatch::set (std::size_t t_index, const Matrix& t_matrix) {
+	if (t_index >= m_count) throw ("Indices are out of bound!");
+	if (t_matrix.getRows() != m_rows || t_matrix.getColumns() != m_columns)
+		throw ("Dimensions of matrix and batch don't match!");
+	const value_type* data = t_matrix.data();
+	for (length_type i = 0; i < m_rows; i++)
+		for (length_type j = 0; j < m_columns; j++)
+			m_data[(std::size_t(i) * m_columns + j) * m_lanes + t_index] = data[i * t_matrix.stride() + j];
+}
+
+MatrixBatch::value_type* MatrixBatch::cell (length_type t_row, length_type t_column) {
+	return m_data + m_cell(0, t_row, t_column);
+}
+
+const MatrixBatch::value_type* MatrixBatch::cell (length_type t_row, length_type t_column) const {
+	return m_data + m_cell(0, t_row, t_column);
+}
+
+MatrixBatch MatrixBatch::operator* (const MatrixBatch& t_batch) const {
+	if (m_count != t_batch.m_count) throw ("Sizes of batches don't match!");
+	if (m_columns != t_batch.m_rows) throw ("Columns of first matrix not equal to rows of second one!");
+	MatrixBatch res(m_count, m_rows, t_batch.m_columns);
+	std::size_t groups = m_lanes / WIDTH;
+	split(groups, m_count * m_rows * m_columns * t_batch.m_columns, [&] (std::size_t t_first, std::size_t t_last) {
+		multiplyGroups(m_data, t_batch.m_data, res.m_data, m_lanes, m_rows, m_columns, t_batch.m_columns, t_first, t_last);
+	});
+	return res;
+}
+
+MatrixBatch& MatrixBatch::transpose () {
+	// every cell is one block of m_lanes values, so only whole blocks move
+	MatrixBatch res(m_count, m_columns, m_rows);
+	for (length_type i = 0; i < m_rows; i++)
+		for (length_type j = 0; j < m_columns; j++)
+			std::memcpy(res.m_data + (std::size_t(j) * m_rows + i) * m_lanes, m_data + (std::size_t(i) * m_columns + j) * m_lanes,
+					m_lanes * sizeof(value_type));
+	return *this = std::move(res);
+}
+
+std::vector<MatrixBatch::value_type> MatrixBatch::determinants () const {
+	if (m_rows != m_columns) throw ("Matrix has no determinant!");
+	std::vector<value_type> res(m_lanes);
+	split(m_lanes / WIDTH, m_count * m_rows * m_rows * m_rows, [&] (std::size_t t_first, std::size_t t_last) {
+		determinantGroups(m_data, res.data(), m_lanes, m_rows, t_first, t_last);
+	});
+	res.resize(m_count);
+	return res;
+}
+
+std::size_t MatrixBatch::invert (std::vector<bool>* t_singular) {
+	if (m_rows != m_columns) throw ("Matrix has no inverse!");
+	return m_solve(nullptr, m_data, m_rows, t_singular);
+}
+
+MatrixBatch MatrixBatch::solve (const MatrixBatch& t_b, std::vector<bool>* t_singular) const {
+	if (m_rows != m_columns) throw ("Only square matrices can be factored!");
+	if (m_count != t_b.m_count) throw ("Sizes of batches don't match!");
+	if (t_b.m_rows != m_rows) throw ("Rows of right-hand side don't match!");
+	MatrixBatch res(t_b);
+	m_solve(res.m_data, res.m_data, t_b.m_columns, t_singular);
+	return res;
+}
+
+std::size_t MatrixBatch::m_cell (std::size_t t_index, length_type t_row, length_type t_column) const {
+	if (t_index >= m_count || t_row >= m_rows || t_column >= m_columns) throw ("Indices are out of bound!");
+	return (std::size_t(t_row) * m_columns + t_column) * m_lanes + t_index;
+}
+
+std::size_t MatrixBatch::m_solve (const value_type* t_b, value_type* t_x, length_type t_columns,
+		std::vector<bool>* t_singular) const {
+	std::vector<char> singular(m_lanes);
+	split(m_lanes / WIDTH, m_count * m_rows * m_rows * (m_rows + t_columns), [&] (std::size_t t_first, std::size_t t_last) {
+		solveGroups(m_data, t_b, t_x, singular.data(), m_lanes, m_rows, t_columns, t_first, t_last);
+	});
+	if (t_singular) t_singular->assign(singular.begin(), singular.begin() + std::ptrdiff_t(m_count));
+	return std::size_t(std::count(singular.begin(), singular.begin() + std::ptrdiff_t(m_count), char(1)));
+}
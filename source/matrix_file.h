@@ -0,0 +1,55 @@
+#ifndef MATRIX_FILE_CRYPT_10_10
+#define MATRIX_FILE_CRYPT_10_10
+
+#include <cstdint>
+#include <cstddef>
+
+namespace m {
+	namespace detail {
+
+		/* binary matrix file: this header, then `seperators` uint32 column indices, then zero padding up to
+		  `payload` (a multiple of 64 bytes from the start of the file), then `rows` rows of `stride` cells each,
+		  of which the first `columns` are the matrix and the rest zero. Everything is in the byte order of the
+		  machine that wrote it, which `byte_order` records. */
+		struct FileHeader {
+			char magic[8];				// "MTRXCRPT"
+			uint32_t version;			// file_version
+			uint32_t byte_order;		// file_byte_order as written by the saving machine
+			uint32_t dtype;				// file_dtype_float32
+			uint32_t rows, columns;
+			uint32_t seperators;		// number of augmentation seperators following the header
+			uint64_t stride;			// cells between the starts of two consecutive rows
+			uint64_t payload;			// byte offset of the first cell
+		};
+
+		constexpr char file_magic[8] = {'M', 'T', 'R', 'X', 'C', 'R', 'P', 'T'};
+		constexpr uint32_t file_version = 1;
+		constexpr uint32_t file_byte_order = 0x01020304;
+		constexpr uint32_t file_dtype_float32 = 1;
+		constexpr std::size_t file_alignment = 64;		// payload offset is a multiple of this
+
+		/* tiled matrix file (see tiled_matrix.h): this header, then zero padding up to `payload`, then one slot of
+		  `tile` x `tile` cells per tile, the tiles going row of tiles after row of tiles. The rows of a tile lie
+		  packed at the start of its slot, so the smaller tiles at the edges leave the end of theirs unused.
+		  The byte order is that of the machine that wrote it, as above. */
+		struct TiledFileHeader {
+			char magic[8];				// "MTRXTILE"
+			uint32_t version;			// file_version
+			uint32_t byte_order;		// file_byte_order as written by the saving machine
+			uint32_t dtype;				// file_dtype_float32
+			uint32_t rows, columns;
+			uint32_t tile;				// rows and columns of a full tile
+			uint64_t payload;			// byte offset of the first slot
+		};
+
+		constexpr char tiled_file_magic[8] = {'M', 'T', 'R', 'X', 'T', 'I', 'L', 'E'};
+
+		// returns the byte offset of the payload of a file with t_seperators seperators
+		inline std::size_t filePayloadOffset (std::size_t t_seperators) {
+			std::size_t end = sizeof(FileHeader) + t_seperators * sizeof(uint32_t);
+			return (end + file_alignment - 1) / file_alignment * file_alignment;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,82 @@
+#include "matrix_resource.h"
+
+using namespace m;
+
+namespace {
+	constexpr std::size_t SMALLEST = 256;		// bytes of the smallest size class
+	constexpr std::size_t ALIGNMENT = 64;		// alignment of every pooled buffer (Matrix::alignment)
+
+	thread_local std::pmr::memory_resource* current = nullptr;
+
+	// returns the size class of t_bytes and sets t_size to the bytes that class holds
+	std::size_t sizeClass (std::size_t t_bytes, std::size_t& t_size) {
+		if (t_bytes <= SMALLEST) { t_size = SMALLEST; return 0; }
+		std::size_t base = SMALLEST, exponent = 0;
+		while (base * 2 < t_bytes) { base *= 2; exponent++; }
+		std::size_t step = base / 4, quarter = (t_bytes - base + step - 1) / step;	// 1 to 4
+		t_size = base + quarter * step;
+		return exponent * 4 + quarter;
+	}
+
+	// returns the bytes size class t_class holds
+	std::size_t classSize (std::size_t t_class) {
+		if (t_class == 0) return SMALLEST;
+		std::size_t base = SMALLEST << ((t_class - 1) / 4);
+		return base + ((t_class - 1) % 4 + 1) * (base / 4);
+	}
+}
+
+std::pmr::memory_resource* m::currentResource () {
+	return current ? current : std::pmr::get_default_resource();
+}
+
+ResourceScope::ResourceScope (std::pmr::memory_resource* t_resource) : m_previous(current) {
+	current = t_resource;
+}
+
+ResourceScope::~ResourceScope () {
+	current = m_previous;
+}
+
+MatrixArena::MatrixArena () : m_upstream(currentResource()), m_scope(this) {}
+
+MatrixArena::~MatrixArena () {
+	release();
+}
+
+void MatrixArena::release () {
+	for (std::size_t k = 0; k < m_free.size(); k++) {
+		for (void* buffer : m_free[k])
+			m_upstream->deallocate(buffer, classSize(k), ALIGNMENT);
+		m_free[k].clear();
+	}
+	m_cached = 0;
+}
+
+std::size_t MatrixArena::cached () const {
+	return m_cached;
+}
+
+void* MatrixArena::do_allocate (std::size_t t_bytes, std::size_t t_alignment) {
+	if (t_alignment > ALIGNMENT) return m_upstream->allocate(t_bytes, t_alignment);
+	std::size_t size = 0, k = sizeClass(t_bytes, size);
+	if (k < m_free.size() && !m_free[k].empty()) {
+		void* buffer = m_free[k].back();
+		m_free[k].pop_back();
+		m_cached -= size;
+		return buffer;
+	}
+	return m_upstream->allocate(size, ALIGNMENT);
+}
+
+void MatrixArena::do_deallocate (void* t_pointer, std::size_t t_bytes, std::size_t t_alignment) {
+	if (t_alignment > ALIGNMENT) { m_upstream->deallocate(t_pointer, t_bytes, t_alignment); return; }
+	std::size_t size = 0, k = sizeClass(t_bytes, size);
+	if (k >= m_free.size()) m_free.resize(k + 1);
+	m_free[k].push_back(t_pointer);
+	m_cached += size;
+}
+
+bool MatrixArena::do_is_equal (const std::pmr::memory_resource& t_other) const noexcept {
+	return this == &t_other;
+}
@@ -0,0 +1,149 @@
+#include <atomic>
+#include <cstdio>
+#include "matrix.h"
+#include "matrix_stats.h"
+
+using namespace m;
+
+namespace {
+	const char* const NAMES[stats::operation_count] = {"multiply", "add", "echelon", "reduced_echelon", "invert",
+			"determinant", "transpose", "copy", "resize", "augment",
+			"scale"};
+
+#ifdef MATRIX_INSTRUMENT
+	// bumped from any thread, so relaxed atomics: totals are exact, a snapshot may be mid-update
+	struct OperationCounters {
+		std::atomic<uint64_t> calls {0}, nanoseconds {0}, flops {0}, bytes {0};
+		std::atomic<uint64_t> histogram[stats::histogram_buckets] {};
+	};
+
+	struct Counters {
+		OperationCounters operations[stats::operation_count];
+		std::atomic<uint64_t> allocations {0}, allocated_bytes {0};
+	};
+
+	Counters& counters () {
+		static Counters instance;
+		return instance;
+	}
+
+	std::size_t bucket (uint64_t t_nanoseconds) {
+		std::size_t k = 0;
+		while (k + 1 < stats::histogram_buckets && t_nanoseconds >= 4) { t_nanoseconds /= 4; k++; }
+		return k;
+	}
+#endif
+}
+
+bool stats::enabled () {
+#ifdef MATRIX_INSTRUMENT
+	return true;
+#else
+	return false;
+#endif
+}
+
+stats::snapshot_type stats::snapshot () {
+	snapshot_type res {};
+#ifdef MATRIX_INSTRUMENT
+	Counters& all = counters();
+	for (std::size_t k = 0; k < operation_count; k++) {
+		const OperationCounters& source = all.operations[k];
+		operation_stats& target = res.operations[k];
+		target.calls = source.calls.load(std::memory_order_relaxed);
+		target.nanoseconds = source.nanoseconds.load(std::memory_order_relaxed);
+		target.flops = source.flops.load(std::memory_order_relaxed);
+		target.bytes = source.bytes.load(std::memory_order_relaxed);
+		for (std::size_t b = 0; b < histogram_buckets; b++)
+			target.histogram[b] = source.histogram[b].load(std::memory_order_relaxed);
+	}
+	res.allocations = all.allocations.load(std::memory_order_relaxed);
+	res.allocated_bytes = all.allocated_bytes.load(std::memory_order_relaxed);
+#endif
+	res.live_matrices = Matrix::getMatricesCount();
+	return res;
+}
+
+void stats::reset () {
+#ifdef MATRIX_INSTRUMENT
+	Counters& all = counters();
+	for (OperationCounters& operation : all.operations) {
+		operation.calls = 0;
+		operation.nanoseconds = 0;
+		operation.flops = 0;
+		operation.bytes = 0;
+		for (std::atomic<uint64_t>& count : operation.histogram) count = 0;
+	}
+	all.allocations = 0;
+	all.allocated_bytes = 0;
+#endif
+}
+
+const char* stats::name (operation_type t_operation) {
+	return t_operation < operation_count ? NAMES[t_operation] : "unknown";
+}
+
+std::string stats::json (const snapshot_type& t_snapshot) {
+	std::string res;
+	char number[32];
+	auto field = [&] (const char* t_key, uint64_t t_value, const char* t_after) {
+		std::snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(t_value));
+		res += "\"";
+		res += t_key;
+		res += "\": ";
+		res += number;
+		res += t_after;
+	};
+	res += "{\"enabled\": ";
+	res += enabled() ? "true" : "false";
+	res += ", ";
+	field("live_matrices", t_snapshot.live_matrices, ", ");
+	field("allocations", t_snapshot.allocations, ", ");
+	field("allocated_bytes", t_snapshot.allocated_bytes, ", ");
+	res += "\"operations\": {";
+	for (std::size_t k = 0; k < operation_count; k++) {
+		const operation_stats& operation = t_snapshot.operations[k];
+		res += k ? ", \"" : "\"";
+		res += NAMES[k];
+		res += "\": {";
+		field("calls", operation.calls, ", ");
+		field("nanoseconds", operation.nanoseconds, ", ");
+		field("flops", operation.flops, ", ");
+		field("bytes", operation.bytes, ", ");
+		res += "\"histogram\": [";
+		for (std::size_t b = 0; b < histogram_buckets; b++) {
+			std::snprintf(number, sizeof(number), b ? ", %llu" : "%llu", static_cast<unsigned long long>(operation.histogram[b]));
+			res += number;
+		}
+		res += "]}";
+	}
+	res += "}}";
+	return res;
+}
+
+void detail::recordAllocation (std::size_t t_bytes) {
+#ifdef MATRIX_INSTRUMENT
+	Counters& all = counters();
+	all.allocations.fetch_add(1, std::memory_order_relaxed);
+	all.allocated_bytes.fetch_add(t_bytes, std::memory_order_relaxed);
+#else
+	(void)t_bytes;
+#endif
+}
+
+#ifdef MATRIX_INSTRUMENT
+detail::OperationTimer::OperationTimer (stats::operation_type t_operation, double t_flops, double t_bytes)
+		: m_operation(t_operation), m_flops(uint64_t(t_flops)), m_bytes(uint64_t(t_bytes)),
+		m_start(std::chrono::steady_clock::now()) {}
+
+detail::OperationTimer::~OperationTimer () {
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start);
+	uint64_t nanoseconds = uint64_t(elapsed.count());
+	OperationCounters& operation = counters().operations[m_operation];
+	operation.calls.fetch_add(1, std::memory_order_relaxed);
+	operation.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+	operation.flops.fetch_add(m_flops, std::memory_order_relaxed);
+	operation.bytes.fetch_add(m_bytes, std::memory_order_relaxed);
+	operation.histogram[bucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+}
+#endif
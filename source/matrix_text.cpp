@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <vector>
+#include "matrix_text.h"
+#include "text_buffer.h"
+
+using namespace m;
+
+namespace {
+	using value_type = Matrix::value_type;
+	using length_type = Matrix::length_type;
+
+	// hands out the lines of a stream, reading it in large blocks (lines are valid until the next call)
+	class LineReader {
+		public:
+			explicit LineReader (std::istream& t_stream) : m_stream(t_stream), m_buffer(std::size_t(1) << 20) {}
+
+			// stores the next line (without its '\n') in t_line, returns false at the end of the stream
+			bool next (std::string_view& t_line) {
+				while (true) {
+					const char* begin = m_buffer.data() + m_begin;
+					const char* newline = static_cast<const char*>(std::memchr(begin, '\n', m_end - m_begin));
+					if (newline) {
+						t_line = std::string_view(begin, std::size_t(newline - begin));
+						m_begin += t_line.size() + 1;
+						return true;
+					}
+					if (m_eof) {	// last line without a '\n'
+						if (m_begin == m_end) return false;
+						t_line = std::string_view(begin, m_end - m_begin);
+						m_begin = m_end;
+						return true;
+					}
+					m_refill();
+				}
+			}
+
+		private:
+			std::istream& m_stream;
+			std::vector<char> m_buffer;
+			std::size_t m_begin {0}, m_end {0};		// unread part of m_buffer
+			bool m_eof {false};
+
+			void m_refill () {
+				// the unfinished line moves to the front; a line longer than the buffer makes it grow
+				std::size_t kept = m_end - m_begin;
+				std::memmove(m_buffer.data(), m_buffer.data() + m_begin, kept);
+				m_begin = 0;
+				m_end = kept;
+				if (m_end == m_buffer.size()) m_buffer.resize(m_buffer.size() * 2);
+				m_stream.read(m_buffer.data() + m_end, std::streamsize(m_buffer.size() - m_end));
+				m_end += std::size_t(m_stream.gcount());
+				if (!m_stream) m_eof = true;
+			}
+	};
+
+	bool isDelimiter (char t_char) {
+		return t_char == ',' || t_char == ';' || t_char == ' ' || t_char == '\t' || t_char == '\r';
+	}
+
+	const char* skipDelimiters (const char* t_first, const char* t_last) {
+		while (t_first != t_last && isDelimiter(*t_first)) t_first++;
+		return t_first;
+	}
+
+	// parses the number at t_first (which must end at a delimiter or t_last) and moves t_first past it
+	template <class T>
+	void parseNumber (const char*& t_first, const char* t_last, T& t_value) {
+		if (t_first != t_last && *t_first == '+') t_first++;	// from_chars takes no plus sign
+		auto result = std::from_chars(t_first, t_last, t_value);
+		if (result.ec != std::errc() || (result.ptr != t_last && !isDelimiter(*result.ptr)))
+			throw ("Not a number in text matrix!");
+		t_first = result.ptr;
+	}
+
+	// appends every number on t_line to t_cells and returns how many there were
+	std::size_t parseLine (std::string_view t_line, std::vector<value_type>& t_cells) {
+		const char* first = t_line.data();
+		const char* last = first + t_line.size();
+		std::size_t count = 0;
+		while ((first = skipDelimiters(first, last)) != last) {
+			value_type value;
+			parseNumber(first, last, value);
+			t_cells.push_back(value);
+			count++;
+		}
+		return count;
+	}
+
+	bool isBlank (std::string_view t_line) {
+		return std::all_of(t_line.begin(), t_line.end(), isDelimiter);
+	}
+
+	// lower-cases the next whitespace separated word of t_line and removes it from t_line
+	std::string nextWord (std::string_view& t_line) {
+		std::size_t first = t_line.find_first_not_of(" \t\r");
+		if (first == std::string_view::npos) { t_line = {}; return {}; }
+		std::size_t last = std::min(t_line.find_first_of(" \t\r", first), t_line.size());
+		std::string word(t_line.substr(first, last - first));
+		t_line.remove_prefix(last);
+		for (char& c : word) if (c >= 'A' && c <= 'Z') c = char(c - 'A' + 'a');
+		return word;
+	}
+
+	// next line of a Matrix Market body that holds data (comments and blank lines skipped)
+	bool nextDataLine (LineReader& t_reader, std::string_view& t_line) {
+		while (t_reader.next(t_line))
+			if (!isBlank(t_line) && t_line[0] != '%') return true;
+		return false;
+	}
+
+	// fills t_matrix row by row from t_cells (t_matrix is t_rows x t_columns)
+	void copyCells (Matrix& t_matrix, const std::vector<value_type>& t_cells) {
+		length_type columns = t_matrix.getColumns();
+		value_type* data = detail::writableView(t_matrix).data();
+		for (length_type i = 0; i < t_matrix.getRows(); i++)
+			std::memcpy(data + std::size_t(i) * t_matrix.stride(), t_cells.data() + std::size_t(i) * columns,
+					columns * sizeof(value_type));
+	}
+
+	int pickPrecision (int t_precision) {
+		return t_precision < 0 ? Matrix::getPrecision() : t_precision;
+	}
+}
+
+Matrix m::readDelimited (std::istream& t_stream) {
+	LineReader reader(t_stream);
+	std::vector<value_type> cells;
+	std::size_t rows = 0, columns = 0;
+	std::string_view line;
+	while (reader.next(line)) {
+		if (isBlank(line) || line[0] == '#') continue;
+		std::size_t count = parseLine(line, cells);
+		if (rows == 0) columns = count;
+		else if (count != columns) throw ("Rows of text matrix differ in length!");
+		rows++;
+	}
+	if (rows == 0) throw ("Number of rows and columns must be positive!");
+	Matrix res(static_cast<length_type>(rows), static_cast<length_type>(columns));
+	copyCells(res, cells);
+	return res;
+}
+
+Matrix m::readDelimited (const std::string& t_path) {
+	std::ifstream file(t_path, std::ios::binary);
+	if (!file) throw ("Couldn't open text file!");
+	return readDelimited(file);
+}
+
+void m::writeDelimited (const ConstMatrixView& t_matrix, std::ostream& t_stream, char t_delimiter, int t_precision) {
+	int precision = pickPrecision(t_precision);
+	{
+		detail::TextBuffer out(t_stream);
+		for (length_type i = 0; i < t_matrix.getRows(); i++) {
+			ConstMatrixView::row_reader row = t_matrix.reader(i);
+			for (length_type j = 0; j < t_matrix.getColumns(); j++) {
+				if (j) out.put(t_delimiter);
+				out.scientific(row[j], precision);
+			}
+			out.put('\n');
+		}
+	}
+	if (!t_stream) throw ("Couldn't write text matrix!");
+}
+
+void m::writeDelimited (const ConstMatrixView& t_matrix, const std::string& t_path, char t_delimiter, int t_precision) {
+	std::ofstream file(t_path, std::ios::binary | std::ios::trunc);
+	if (!file) throw ("Couldn't open text file!");
+	writeDelimited(t_matrix, file, t_delimiter, t_precision);
+	file.flush();
+	if (!file) throw ("Couldn't write text matrix!");
+}
+
+Matrix m::readMatrixMarket (std::istream& t_stream) {
+	LineReader reader(t_stream);
+	std::string_view line;
+	if (!reader.next(line) || nextWord(line) != "%%matrixmarket") throw ("Not a Matrix Market file!");
+	std::string object = nextWord(line), format = nextWord(line), field = nextWord(line), symmetry = nextWord(line);
+	if (object != "matrix" || (format != "array" && format != "coordinate")) throw ("Not a Matrix Market file!");
+	if (field != "real" && field != "double" && field != "integer" && field != "pattern")
+		throw ("Unsupported Matrix Market file!");
+	if (symmetry != "general" && symmetry != "symmetric" && symmetry != "skew-symmetric")
+		throw ("Unsupported Matrix Market file!");
+	bool coordinate = format == "coordinate", pattern = field == "pattern";
+	bool symmetric = symmetry == "symmetric", skew = symmetry == "skew-symmetric";
+	if (pattern && !coordinate) throw ("Not a Matrix Market file!");
+
+	if (!nextDataLine(reader, line)) throw ("Matrix Market file is truncated!");
+	std::size_t sizes[3] = {0, 0, 0};
+	{
+		const char* first = line.data();
+		const char* last = first + line.size();
+		for (int k = 0; k < (coordinate ? 3 : 2); k++) {
+			first = skipDelimiters(first, last);
+			parseNumber(first, last, sizes[k]);
+		}
+	}
+	if (sizes[0] == 0 || sizes[1] == 0 || sizes[0] > UINT32_MAX || sizes[1] > UINT32_MAX)
+		throw ("Number of rows and columns must be positive!");
+	if ((symmetric || skew) && sizes[0] != sizes[1]) throw ("Symmetric Matrix Market matrix must be square!");
+	length_type rows = length_type(sizes[0]), columns = length_type(sizes[1]);
+	Matrix res(rows, columns);
+	value_type* data = detail::writableView(res).data();
+	std::size_t stride = res.stride();
+
+	if (!coordinate) {
+		// values come column by column; symmetric files only hold the lower triangle (skew: below the diagonal)
+		std::vector<value_type> values;
+		length_type i = 0, j = 0;
+		auto first_row = [&] (length_type t_column) { return symmetric ? t_column : skew ? t_column + 1 : 0; };
+		i = first_row(0);
+		while (j < columns && i >= rows) i = first_row(++j);	// 1x1 skew-symmetric matrix holds nothing
+		while (j < columns && nextDataLine(reader, line)) {
+			values.clear();
+			parseLine(line, values);
+			for (value_type value : values) {
+				if (j == columns) throw ("Too many values in Matrix Market file!");
+				data[i * stride + j] = value;
+				if (symmetric) data[j * stride + i] = value;
+				if (skew) data[j * stride + i] = -value;
+				if (++i == rows)
+					while (++j < columns && (i = first_row(j)) >= rows) {}
+			}
+		}
+		if (j < columns) throw ("Matrix Market file is truncated!");
+		return res;
+	}
+
+	for (std::size_t entry = 0; entry < sizes[2]; entry++) {
+		if (!nextDataLine(reader, line)) throw ("Matrix Market file is truncated!");
+		const char* first = line.data();
+		const char* last = first + line.size();
+		std::size_t i, j;
+		value_type value = value_type(1);
+		first = skipDelimiters(first, last);
+		parseNumber(first, last, i);
+		first = skipDelimiters(first, last);
+		parseNumber(first, last, j);
+		if (!pattern) {
+			first = skipDelimiters(first, last);
+			parseNumber(first, last, value);
+		}
+		if (i == 0 || j == 0 || i > rows || j > columns) throw ("Index out of bound in Matrix Market file!");
+		i--; j--;
+		data[i * stride + j] += value;
+		if (i != j && symmetric) data[j * stride + i] += value;
+		if (i != j && skew) data[j * stride + i] -= value;
+	}
+	return res;
+}
+
+Matrix m::readMatrixMarket (const std::string& t_path) {
+	std::ifstream file(t_path, std::ios::binary);
+	if (!file) throw ("Couldn't open text file!");
+	return readMatrixMarket(file);
+}
+
+void m::writeMatrixMarket (const ConstMatrixView& t_matrix, std::ostream& t_stream, int t_precision) {
+	int precision = pickPrecision(t_precision);
+	{
+		detail::TextBuffer out(t_stream);
+		out.put("%%MatrixMarket matrix array real general\n");
+		out.integer(t_matrix.getRows());
+		out.put(' ');
+		out.integer(t_matrix.getColumns());
+		out.put('\n');
+		for (length_type j = 0; j < t_matrix.getColumns(); j++)
+			for (length_type i = 0; i < t_matrix.getRows(); i++) {
+				out.scientific(t_matrix.data()[i * t_matrix.stride() + j], precision);
+				out.put('\n');
+			}
+	}
+	if (!t_stream) throw ("Couldn't write text matrix!");
+}
+
+void m::writeMatrixMarket (const ConstMatrixView& t_matrix, const std::string& t_path, int t_precision) {
+	std::ofstream file(t_path, std::ios::binary | std::ios::trunc);
+	if (!file) throw ("Couldn't open text file!");
+	writeMatrixMarket(t_matrix, file, t_precision);
+	file.flush();
+	if (!file) throw ("Couldn't write text matrix!");
+}
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include "matrix.h"
+#include "matrix_view.h"
+#include "text_buffer.h"
+
+using namespace m;
+
+void detail::printCells (const ConstMatrixView& t_view, const std::vector<uint32_t>& t_seperators) {
+	// formatted into a buffer that goes out in blocks; the text is what std::scientific would give
+	TextBuffer out(std::cout);
+	int precision = Matrix::getPrecision();
+	std::size_t index { 0 };
+	out.put('\n');
+	for (ConstMatrixView::length_type i = 0; i < t_view.getRows(); i++) {
+		ConstMatrixView::row_reader row = t_view.reader(i);
+		out.put("[ ");
+		for (ConstMatrixView::length_type j = 0; j < t_view.getColumns(); j++) {
+			if (row[j] >= 0) out.put(' ');
+			out.scientific(row[j], precision);
+			out.put(' ');
+			if (index < t_seperators.size() && t_seperators[index] == j) {
+				out.put("| ");
+				index++;
+			}
+		}
+		index = 0;
+		out.put("]\n");
+	}
+	out.put('\n');
+}
+
+ConstMatrixView::value_type ConstMatrixView::getCell (length_type t_row, length_type t_column) const {
+	if (t_row >= m_rows || t_column >= m_columns) throw ("Indices are out of bound!");
+	return m_data[std::size_t(t_row) * m_stride + t_column];
+}
+
+ConstMatrixView ConstMatrixView::view (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) const {
+	return ConstMatrixView(m_data + m_offset(t_i0, t_j0, t_i1, t_j1), t_i1 - t_i0 + 1, t_j1 - t_j0 + 1, m_stride);
+}
+
+void ConstMatrixView::print () const {
+	detail::printCells(*this, {});
+}
+
+std::size_t ConstMatrixView::m_offset (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) const {
+	if (t_i0 > t_i1 || t_j0 > t_j1)
+		throw("Number of rows and columns of submatrix must be positive!");
+	if (t_i1 >= m_rows || t_j1 >= m_columns)
+		throw("Rows and Columns of submatrix must be contained in the main matrix!");
+	return std::size_t(t_i0) * m_stride + t_j0;
+}
+
+void MatrixView::setCell (length_type t_row, length_type t_column, value_type t_value) {
+	if (t_row >= m_rows || t_column >= m_columns) throw ("Indices are out of bound!");
+	m_data[std::size_t(t_row) * m_stride + t_column] = t_value;
+}
+
+void MatrixView::fill (value_type t_constant) {
+	for (length_type i = 0; i < m_rows; i++)
+		std::fill_n(m_data + std::size_t(i) * m_stride, m_columns, t_constant);
+}
+
+MatrixView MatrixView::view (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) const {
+	return MatrixView(m_data + m_offset(t_i0, t_j0, t_i1, t_j1), t_i1 - t_i0 + 1, t_j1 - t_j0 + 1, m_stride);
+}
+
+MatrixView& MatrixView::operator= (const MatrixView& t_view) {
+	if (t_view.m_rows != m_rows || t_view.m_columns != m_columns)
+		throw ("Dimensions of view and expression don't match!");
+	if (t_view.m_data == m_data) return *this;
+	M_INSTRUMENT(copy, 0, 2.0 * sizeof(value_type) * m_rows * m_columns);
+	// rows of overlapping views may sit in either order, memmove copes with both
+	for (length_type i = 0; i < m_rows; i++) {
+		length_type row = t_view.m_data > m_data ? i : m_rows - 1 - i;
+		std::memmove(m_data + std::size_t(row) * m_stride, t_view.m_data + std::size_t(row) * t_view.m_stride,
+				m_columns * sizeof(value_type));
+	}
+	return *this;
+}
+
+MatrixView& MatrixView::operator*= (value_type t_constant) {
+	return *this = *this * t_constant;
+}
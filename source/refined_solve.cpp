@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "refined_solve.h"
+#include "lu.h"
+#include "thread_pool.h"
+
+using namespace m;
+
+namespace {
+	using value_type = Matrix::value_type;
+	using length_type = Matrix::length_type;
+
+	constexpr std::size_t PARALLEL_CELLS = 1 << 15;		// smaller loops stay on the calling thread
+
+	// calls t_body(first, last) over [0, t_count) split across the pool when t_work cells are touched
+	template <class Body>
+	void split (std::size_t t_count, std::size_t t_work, Body&& t_body) {
+		detail::ThreadPool& pool = detail::ThreadPool::instance();
+		if (pool.size() <= 1 || t_work < PARALLEL_CELLS || t_count < 2) { t_body(std::size_t(0), t_count); return; }
+		std::size_t grain = std::max<std::size_t>(1, t_count / (std::size_t(pool.size()) * 4));
+		pool.parallelFor(0, t_count, grain, t_body);
+	}
+
+	// the system being solved, A in double row by row
+	struct System {
+		const std::vector<double>& a;
+		length_type n;
+		const std::vector<double>& b;
+		double norm_a;			// ||A|| in the infinity norm
+		double tolerance;		// backward error refining stops at
+	};
+
+	double norm (const std::vector<double>& t_vector) {
+		double res = 0;
+		for (double cell : t_vector)
+			res = std::max(res, std::fabs(cell));
+		return res;
+	}
+
+	// largest sum of the magnitudes of a row of the t_n x t_n matrix t_a
+	double matrixNorm (const std::vector<double>& t_a, length_type t_n) {
+		double res = 0;
+		for (std::size_t i = 0; i < t_n; i++) {
+			double sum = 0;
+			for (std::size_t k = 0; k < t_n; k++)
+				sum += std::fabs(t_a[i * t_n + k]);
+			res = std::max(res, sum);
+		}
+		return res;
+	}
+
+	// t_r = b - A * t_x in double, rows across the pool; returns ||t_r||
+	double residual (const System& t_system, const std::vector<double>& t_x, std::vector<double>& t_r) {
+		std::size_t n = t_system.n;
+		split(n, n * n, [&] (std::size_t t_first, std::size_t t_last) {
+			for (std::size_t i = t_first; i < t_last; i++) {
+				const double* row = t_system.a.data() + i * n;
+				double sum = t_system.b[i];
+				for (std::size_t k = 0; k < n; k++)
+					sum -= row[k] * t_x[k];
+				t_r[i] = sum;
+			}
+		});
+		return norm(t_r);
+	}
+
+	/* solves A * d = r for d = x - x_k and adds it to t_res.x, until the backward error is down to the
+	  tolerance. t_solve(r) overwrites r with d; the first d is the solution itself, as x starts at zero.
+	  Returns false if t_max_iterations refinement steps didn't get there, or if a correction wasn't at
+	  most half the one before it (it isn't applied then). */
+	template <class Solve>
+	bool refine (const System& t_system, RefinedSolution& t_res, unsigned t_max_iterations, Solve&& t_solve) {
+		std::vector<double>& x = t_res.x;
+		x.assign(t_system.n, 0.0);
+		std::vector<double> r(t_system.n);
+		double previous = std::numeric_limits<double>::infinity();
+		for (unsigned step = 0; ; step++) {
+			double norm_r = residual(t_system, x, r), scale = t_system.norm_a * norm(x);
+			t_res.backward_error = norm_r == 0 ? 0 : scale > 0 ? norm_r / scale : std::numeric_limits<double>::infinity();
+			if (t_res.backward_error <= t_system.tolerance) return true;
+			if (step > t_max_iterations) return false;
+			// the residual is scaled to 1 on the way, so a float copy of it neither underflows nor overflows
+			for (double& cell : r) cell /= norm_r;
+			t_solve(r);
+			double norm_d = norm_r * norm(r);
+			if (!(norm_d <= previous / 2)) return false;	// stalled, or no longer finite
+			for (std::size_t i = 0; i < t_system.n; i++)
+				x[i] += norm_r * r[i];
+			previous = norm_d;
+			if (step > 0) t_res.iterations++;
+		}
+	}
+
+	// PLU of the t_n x t_n matrix t_a in double, in place, rows of the trailing matrix across the pool (false if singular)
+	bool factor (std::vector<double>& t_a, length_type t_n, std::vector<length_type>& t_pivots) {
+		std::size_t n = t_n;
+		t_pivots.resize(n);
+		for (std::size_t j = 0; j < n; j++) {
+			std::size_t pivot = j;
+			double largest = std::fabs(t_a[j * n + j]);
+			for (std::size_t i = j + 1; i < n; i++)
+				if (std::fabs(t_a[i * n + j]) > largest) { largest = std::fabs(t_a[i * n + j]); pivot = i; }
+			t_pivots[j] = length_type(pivot);
+			if (largest == 0) return false;
+			if (pivot != j) std::swap_ranges(t_a.begin() + std::ptrdiff_t(j * n), t_a.begin() + std::ptrdiff_t((j + 1) * n),
+					t_a.begin() + std::ptrdiff_t(pivot * n));
+			const double* pivot_row = t_a.data() + j * n;
+			split(n - j - 1, (n - j - 1) * (n - j), [&] (std::size_t t_first, std::size_t t_last) {
+				for (std::size_t i = j + 1 + t_first; i < j + 1 + t_last; i++) {
+					double* row = t_a.data() + i * n;
+					double multiple = row[j] /= pivot_row[j];
+					if (multiple == 0) continue;
+					for (std::size_t c = j + 1; c < n; c++)
+						row[c] -= multiple * pivot_row[c];
+				}
+			});
+		}
+		return true;
+	}
+
+	// overwrites t_b with the solution of the system t_lu and t_pivots are the factors of
+	void substitute (const std::vector<double>& t_lu, const std::vector<length_type>& t_pivots, std::vector<double>& t_b) {
+		std::size_t n = t_pivots.size();
+		for (std::size_t i = 0; i < n; i++)
+			if (t_pivots[i] != i) std::swap(t_b[i], t_b[t_pivots[i]]);
+		for (std::size_t i = 0; i < n; i++)		// L * y = P * b
+			for (std::size_t k = 0; k < i; k++)
+				t_b[i] -= t_lu[i * n + k] * t_b[k];
+		for (std::size_t i = n; i-- > 0; ) {	// U * x = y
+			for (std::size_t k = i + 1; k < n; k++)
+				t_b[i] -= t_lu[i * n + k] * t_b[k];
+			t_b[i] /= t_lu[i * n + i];
+		}
+	}
+
+	// t_single is A rounded to float
+	RefinedSolution solveSystem (const std::vector<double>& t_a, length_type t_n, const Matrix& t_single,
+			const std::vector<double>& t_b, unsigned t_max_iterations) {
+		if (t_b.size() != t_n) throw ("Size of right-hand side doesn't match!");
+		System system {t_a, t_n, t_b, matrixNorm(t_a, t_n), std::sqrt(double(t_n)) * std::numeric_limits<double>::epsilon()};
+		RefinedSolution res;
+		LU factorization(t_single);
+		if (!factorization.isSingular()) {
+			std::vector<value_type> single(t_n);
+			res.converged = refine(system, res, t_max_iterations, [&] (std::vector<double>& t_r) {
+				for (std::size_t i = 0; i < t_n; i++)
+					single[i] = value_type(t_r[i]);
+				single = factorization.solve(single);
+				for (std::size_t i = 0; i < t_n; i++)
+					t_r[i] = double(single[i]);
+			});
+			if (res.converged) return res;
+		}
+
+		// falling back to double, refining with the double factors (which seldom takes a step)
+		std::vector<double> lu(t_a);
+		std::vector<length_type> pivots;
+		if (!factor(lu, t_n, pivots)) throw ("Matrix with zero determinant!");
+		unsigned iterations = res.iterations;
+		res.fell_back = true;
+		res.converged = refine(system, res, t_max_iterations, [&] (std::vector<double>& t_r) {
+			substitute(lu, pivots, t_r);
+		});
+		res.iterations = iterations;
+		return res;
+	}
+}
+
+RefinedSolution m::refinedSolve (const Matrix& t_a, const std::vector<double>& t_b, unsigned t_max_iterations) {
+	if (t_a.getRows() != t_a.getColumns()) throw ("Only square matrices can be factored!");
+	length_type n = t_a.getRows();
+	std::vector<double> a(std::size_t(n) * n);
+	const value_type* cells = t_a.data();
+	for (std::size_t i = 0; i < n; i++)
+		for (std::size_t j = 0; j < n; j++)
+			a[i * n + j] = double(cells[i * t_a.stride() + j]);
+	return solveSystem(a, n, t_a, t_b, t_max_iterations);
+}
+
+RefinedSolution m::refinedSolve (const std::vector<double>& t_a, Matrix::length_type t_n, const std::vector<double>& t_b,
+		unsigned t_max_iterations) {
+	if (t_a.size() != std::size_t(t_n) * t_n) throw ("Size of matrix doesn't match!");
+	Matrix single(t_n, t_n);
+	value_type* cells = detail::writableView(single).data();
+	for (std::size_t i = 0; i < t_n; i++)
+		for (std::size_t j = 0; j < t_n; j++)
+			cells[i * single.stride() + j] = value_type(t_a[i * t_n + j]);
+	return solveSystem(t_a, t_n, single, t_b, t_max_iterations);
+}
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "sparse_matrix.h"
+#include "thread_pool.h"
+
+using namespace m;
+
+namespace {
+	constexpr std::size_t PARALLEL_WORK = 1 << 15;		// products touching fewer cells stay on the calling thread
+
+	// calls t_body(first, last) over [0, t_count) split across the pool when t_work multiply-adds are done
+	template <class Body>
+	void split (std::size_t t_count, std::size_t t_work, Body&& t_body) {
+		detail::ThreadPool& pool = detail::ThreadPool::instance();
+		if (pool.size() <= 1 || t_work < PARALLEL_WORK || t_count < 2) { t_body(std::size_t(0), t_count); return; }
+		std::size_t grain = std::max<std::size_t>(1, t_count / (std::size_t(pool.size()) * 4));
+		pool.parallelFor(0, t_count, grain, t_body);
+	}
+}
+
+SparseMatrix::SparseMatrix (length_type t_rows, length_type t_columns, format_type t_format)
+		: m_rows(t_rows), m_columns(t_columns), m_format(t_format), m_offsets(std::size_t(m_major()) + 1, 0) {
+	if (t_rows == 0 || t_columns == 0) throw ("Number of rows and columns must be positive!");
+}
+
+SparseMatrix::SparseMatrix (length_type t_rows, length_type t_columns, const std::vector<triplet>& t_triplets,
+		format_type t_format) : SparseMatrix(t_rows, t_columns, t_format) {
+	// counting sort by row (csr) or column (csc), then every row is sorted and repeated cells summed
+	for (const triplet& cell : t_triplets) {
+		if (cell.row >= m_rows || cell.column >= m_columns) throw ("Indices are out of bound!");
+		m_offsets[std::size_t(m_format == csr ? cell.row : cell.column) + 1]++;
+	}
+	for (length_type k = 0; k < m_major(); k++)
+		m_offsets[k + 1] += m_offsets[k];
+	m_indices.resize(t_triplets.size());
+	m_values.resize(t_triplets.size());
+	std::vector<std::size_t> next(m_offsets.begin(), m_offsets.end() - 1);
+	for (const triplet& cell : t_triplets) {
+		std::size_t position = next[m_format == csr ? cell.row : cell.column]++;
+		m_indices[position] = m_format == csr ? cell.column : cell.row;
+		m_values[position] = cell.value;
+	}
+
+	std::vector<std::pair<length_type, value_type>> segment;
+	std::size_t kept = 0;
+	for (length_type k = 0; k < m_major(); k++) {
+		std::size_t first = m_offsets[k], last = m_offsets[k + 1];
+		segment.clear();
+		for (std::size_t p = first; p < last; p++)
+			segment.emplace_back(m_indices[p], m_values[p]);
+		// stable, so repeated cells are summed in the order they were given
+		std::stable_sort(segment.begin(), segment.end(),
+				[] (const auto& t_a, const auto& t_b) { return t_a.first < t_b.first; });
+		m_offsets[k] = kept;
+		for (std::size_t p = 0; p < segment.size(); p++) {
+			if (p > 0 && segment[p].first == segment[p - 1].first) { m_values[kept - 1] += segment[p].second; continue; }
+			m_indices[kept] = segment[p].first;
+			m_values[kept] = segment[p].second;
+			kept++;
+		}
+	}
+	m_offsets[m_major()] = kept;
+	m_indices.resize(kept);
+	m_values.resize(kept);
+}
+
+SparseMatrix::SparseMatrix (const Matrix& t_matrix, value_type t_tolerance, format_type t_format)
+		: SparseMatrix(t_matrix.view(), t_tolerance, t_format) {}
+
+SparseMatrix::SparseMatrix (const ConstMatrixView& t_matrix, value_type t_tolerance, format_type t_format)
+		: SparseMatrix(t_matrix.getRows(), t_matrix.getColumns(), csr) {
+	m_fromView(t_matrix, t_tolerance);
+	convert(t_format);
+}
+
+SparseMatrix::length_type SparseMatrix::getRows () const {
+	return m_rows;
+}
+
+SparseMatrix::length_type SparseMatrix::getColumns () const {
+	return m_columns;
+}
+
+std::size_t SparseMatrix::getNonZeros () const {
+	return m_values.size();
+}
+
+SparseMatrix::format_type SparseMatrix::getFormat () const {
+	return m_format;
+}
+
+SparseMatrix::value_type SparseMatrix::getCell (length_type t_row, length_type t_column) const {
+	if (t_row >= m_rows || t_column >= m_columns) throw ("Indices are out of bound!");
+	length_type major = m_format == csr ? t_row : t_column, minor = m_format == csr ? t_column : t_row;
+	auto first = m_indices.begin() + std::ptrdiff_t(m_offsets[major]);
+	auto last = m_indices.begin() + std::ptrdiff_t(m_offsets[major + 1]);
+	auto found = std::lower_bound(first, last, minor);
+	if (found == last || *found != minor) return value_type(0);
+	return m_values[std::size_t(found - m_indices.begin())];
+}
+
+SparseMatrix& SparseMatrix::convert (format_type t_format) {
+	if (t_format == m_format) return *this;
+	// counting sort by the other index; walking the old rows in order keeps the new ones sorted
+	length_type major = m_major(), minor = m_minor();
+	std::vector<std::size_t> offsets(std::size_t(minor) + 1, 0);
+	for (length_type index : m_indices)
+		offsets[std::size_t(index) + 1]++;
+	for (length_type k = 0; k < minor; k++)
+		offsets[k + 1] += offsets[k];
+	std::vector<length_type> indices(m_indices.size());
+	std::vector<value_type> values(m_values.size());
+	std::vector<std::size_t> next(offsets.begin(), offsets.end() - 1);
+	for (length_type k = 0; k < major; k++)
+		for (std::size_t p = m_offsets[k]; p < m_offsets[k + 1]; p++) {
+			std::size_t position = next[m_indices[p]]++;
+			indices[position] = k;
+			values[position] = m_values[p];
+		}
+	m_offsets = std::move(offsets);
+	m_indices = std::move(indices);
+	m_values = std::move(values);
+	m_format = t_format;
+	return *this;
+}
+
+SparseMatrix& SparseMatrix::transpose () {
+	std::swap(m_rows, m_columns);
+	m_format = m_format == csr ? csc : csr;
+	return *this;
+}
+
+Matrix SparseMatrix::toDense () const {
+	Matrix res(m_rows, m_columns);
+	value_type* data = detail::writableView(res).data();
+	std::size_t stride = res.stride();
+	bool rows = m_format == csr;
+	// every row (or column) owns its cells of the result, so they can be filled in parallel
+	split(m_major(), m_values.size(), [&] (std::size_t t_first, std::size_t t_last) {
+		for (std::size_t k = t_first; k < t_last; k++)
+			for (std::size_t p = m_offsets[k]; p < m_offsets[k + 1]; p++) {
+				if (rows) data[k * stride + m_indices[p]] = m_values[p];
+				else data[std::size_t(m_indices[p]) * stride + k] = m_values[p];
+			}
+	});
+	return res;
+}
+
+void SparseMatrix::multiply (const std::vector<value_type>& t_x, std::vector<value_type>& t_y) const {
+	if (t_x.size() != m_columns) throw ("Size of vector doesn't match!");
+	if (&t_x == &t_y) {
+		std::vector<value_type> x(t_x);
+		multiply(x, t_y);
+		return;
+	}
+	t_y.assign(m_rows, value_type(0));
+	if (m_format == csc) {	// columns scatter into every row, so this one stays on the calling thread
+		for (length_type k = 0; k < m_columns; k++)
+			for (std::size_t p = m_offsets[k]; p < m_offsets[k + 1]; p++)
+				t_y[m_indices[p]] += m_values[p] * t_x[k];
+		return;
+	}
+	split(m_rows, m_values.size(), [&] (std::size_t t_first, std::size_t t_last) {
+		for (std::size_t i = t_first; i < t_last; i++) {
+			value_type sum = value_type(0);
+			for (std::size_t p = m_offsets[i]; p < m_offsets[i + 1]; p++)
+				sum += m_values[p] * t_x[m_indices[p]];
+			t_y[i] = sum;
+		}
+	});
+}
+
+std::vector<SparseMatrix::value_type> SparseMatrix::operator* (const std::vector<value_type>& t_x) const {
+	std::vector<value_type> y;
+	multiply(t_x, y);
+	return y;
+}
+
+Matrix SparseMatrix::operator* (const Matrix& t_matrix) const {
+	return *this * t_matrix.view();
+}
+
+Matrix SparseMatrix::operator* (const ConstMatrixView& t_matrix) const {
+	if (m_columns != t_matrix.getRows()) throw ("Columns of first matrix not equal to rows of second one!");
+	length_type columns = t_matrix.getColumns();
+	Matrix res(m_rows, columns);
+	value_type* out = detail::writableView(res).data();
+	std::size_t ldc = res.stride(), ldb = t_matrix.stride();
+	const value_type* b = t_matrix.data();
+	std::size_t work = m_values.size() * columns;
+
+	if (m_format == csr) {	// row i of the result is the sum of the rows of t_matrix picked by row i
+		split(m_rows, work, [&] (std::size_t t_first, std::size_t t_last) {
+			for (std::size_t i = t_first; i < t_last; i++) {
+				value_type* row = out + i * ldc;
+				for (std::size_t p = m_offsets[i]; p < m_offsets[i + 1]; p++) {
+					value_type a = m_values[p];
+					const value_type* source = b + std::size_t(m_indices[p]) * ldb;
+					for (length_type c = 0; c < columns; c++)
+						row[c] += a * source[c];
+				}
+			}
+		});
+		return res;
+	}
+	// csc scatters into any row of the result, so threads take strips of its columns instead
+	split(columns, work, [&] (std::size_t t_first, std::size_t t_last) {
+		for (length_type k = 0; k < m_columns; k++) {
+			const value_type* source = b + std::size_t(k) * ldb;
+			for (std::size_t p = m_offsets[k]; p < m_offsets[k + 1]; p++) {
+				value_type a = m_values[p];
+				value_type* row = out + std::size_t(m_indices[p]) * ldc;
+				for (std::size_t c = t_first; c < t_last; c++)
+					row[c] += a * source[c];
+			}
+		}
+	});
+	return res;
+}
+
+const std::vector<std::size_t>& SparseMatrix::offsets () const {
+	return m_offsets;
+}
+
+const std::vector<SparseMatrix::length_type>& SparseMatrix::indices () const {
+	return m_indices;
+}
+
+const std::vector<SparseMatrix::value_type>& SparseMatrix::values () const {
+	return m_values;
+}
+
+void SparseMatrix::m_fromView (const ConstMatrixView& t_matrix, value_type t_tolerance) {
+	// kept cells are counted per row, then written; rows are independent in both passes
+	auto kept = [t_tolerance] (value_type t_value) { return !(std::fabs(t_value) <= t_tolerance); };	// NaN is kept
+	std::size_t cells = std::size_t(m_rows) * m_columns;
+	split(m_rows, cells, [&] (std::size_t t_first, std::size_t t_last) {
+		for (std::size_t i = t_first; i < t_last; i++) {
+			ConstMatrixView::row_reader row = t_matrix.reader(length_type(i));
+			std::size_t count = 0;
+			for (length_type j = 0; j < m_columns; j++)
+				if (kept(row[j])) count++;
+			m_offsets[i + 1] = count;
+		}
+	});
+	for (length_type i = 0; i < m_rows; i++)
+		m_offsets[i + 1] += m_offsets[i];
+	m_indices.resize(m_offsets[m_rows]);
+	m_values.resize(m_offsets[m_rows]);
+	split(m_rows, cells, [&] (std::size_t t_first, std::size_t t_last) {
+		for (std::size_t i = t_first; i < t_last; i++) {
+			ConstMatrixView::row_reader row = t_matrix.reader(length_type(i));
+			std::size_t position = m_offsets[i];
+			for (length_type j = 0; j < m_columns; j++)
+				if (kept(row[j])) {
+					m_indices[position] = j;
+					m_values[position] = row[j];
+					position++;
+				}
+		}
+	});
+}
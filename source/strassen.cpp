@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include "strassen.h"
+#include "gemm.h"
+#include "thread_pool.h"
+
+using namespace m;
+using namespace m::detail;
+
+namespace {
+	constexpr std::size_t PARALLEL_CELLS = 1 << 15;		// smaller block additions stay on the calling thread
+
+	// calls t_body(first, last) over [0, t_count) split across the pool when t_work cells are touched
+	template <class Body>
+	void split (std::size_t t_count, std::size_t t_work, Body&& t_body) {
+		ThreadPool& pool = ThreadPool::instance();
+		if (pool.size() <= 1 || t_work < PARALLEL_CELLS || t_count < 2) { t_body(std::size_t(0), t_count); return; }
+		std::size_t grain = std::max<std::size_t>(1, t_count / (std::size_t(pool.size()) * 4));
+		pool.parallelFor(0, t_count, grain, t_body);
+	}
+
+	/* scratch cells for one product. The largest block handed back is kept for the next product, so a
+	  run of large products allocates once; products running at the same time take blocks of their own */
+	class Workspace {
+		public:
+			explicit Workspace (std::size_t t_count) {
+				{
+					std::lock_guard<std::mutex> guard(lock());
+					if (cached().capacity >= t_count) std::swap(m_block, cached());
+				}
+				if (m_block.capacity < t_count) {
+					M_INSTRUMENT_ALLOCATION(t_count * sizeof(value_type));
+					m_block.data = static_cast<value_type*>(::operator new(t_count * sizeof(value_type), std::align_val_t(Matrix::alignment)));
+					m_block.capacity = t_count;
+				}
+			}
+			Workspace (const Workspace&) = delete;
+			Workspace& operator= (const Workspace&) = delete;
+			~Workspace () {
+				std::lock_guard<std::mutex> guard(lock());
+				if (cached().capacity < m_block.capacity) std::swap(m_block, cached());
+				release(m_block);
+			}
+
+			value_type* data () const { return m_block.data; }
+		private:
+			struct Block {
+				value_type* data {nullptr};
+				std::size_t capacity {0};
+			};
+			struct Cache {
+				Block block {};
+				~Cache () { release(block); }
+			};
+
+			Block m_block {};
+
+			static std::mutex& lock () {
+				static std::mutex instance;
+				return instance;
+			}
+			static Block& cached () {
+				static Cache instance;
+				return instance.block;
+			}
+			static void release (Block& t_block) {
+				if (t_block.data) ::operator delete(t_block.data, std::align_val_t(Matrix::alignment));
+				t_block = Block {};
+			}
+	};
+
+	// a t_rows x t_columns block: cell (i, j) at data[i * ld + j]
+	struct Block {
+		value_type* data;
+		std::size_t ld;
+	};
+
+	struct ConstBlock {
+		const value_type* data;
+		std::size_t ld;
+		ConstBlock (const value_type* t_data, std::size_t t_ld) : data(t_data), ld(t_ld) {}
+		ConstBlock (const Block& t_block) : data(t_block.data), ld(t_block.ld) {}
+	};
+
+	// t_c = t_a + t_sign * t_b over t_rows x t_columns cells (t_c may be t_a or t_b)
+	void combine (length_type t_rows, length_type t_columns, ConstBlock t_a, value_type t_sign, ConstBlock t_b, Block t_c) {
+		split(t_rows, std::size_t(t_rows) * t_columns, [&] (std::size_t t_first, std::size_t t_last) {
+			for (std::size_t i = t_first; i < t_last; i++) {
+				const value_type* a = t_a.data + i * t_a.ld;
+				const value_type* b = t_b.data + i * t_b.ld;
+				value_type* c = t_c.data + i * t_c.ld;
+				for (length_type j = 0; j < t_columns; j++)
+					c[j] = a[j] + t_sign * b[j];
+			}
+		});
+	}
+
+	bool leaf (length_type t_m, length_type t_n, length_type t_k, length_type t_crossover) {
+		return std::min(t_m, std::min(t_n, t_k)) <= t_crossover;
+	}
+
+	// cells of workspace a product computed one block product after the other needs
+	std::size_t sequentialWorkspace (length_type t_m, length_type t_n, length_type t_k, length_type t_crossover) {
+		if (leaf(t_m, t_n, t_k, t_crossover)) return 0;
+		std::size_t mh = t_m / 2, nh = t_n / 2, kh = t_k / 2;
+		return mh * kh + kh * nh + mh * nh + sequentialWorkspace(t_m / 2, t_n / 2, t_k / 2, t_crossover);
+	}
+
+	// cells of workspace a product whose first level runs its 7 block products at once needs
+	std::size_t parallelWorkspace (length_type t_m, length_type t_n, length_type t_k, length_type t_crossover) {
+		if (leaf(t_m, t_n, t_k, t_crossover)) return 0;
+		std::size_t mh = t_m / 2, nh = t_n / 2, kh = t_k / 2;
+		return 4 * mh * kh + 4 * kh * nh + 3 * mh * nh + 7 * sequentialWorkspace(t_m / 2, t_n / 2, t_k / 2, t_crossover);
+	}
+
+	void recurse (length_type t_m, length_type t_n, length_type t_k, ConstBlock t_a, ConstBlock t_b, Block t_c,
+			length_type t_crossover, value_type* t_work, bool t_parallel);
+
+	/* the even part of one level with three temporaries X, Y and Z, the block products computed straight
+	  into the blocks of C (the schedule of Douglas, Heroux, Slishman and Smith) */
+	void sequentialLevel (length_type t_mh, length_type t_nh, length_type t_kh, ConstBlock t_a, ConstBlock t_b, Block t_c,
+			length_type t_crossover, value_type* t_work) {
+		ConstBlock a11 = t_a, a12 {t_a.data + t_kh, t_a.ld}, a21 {t_a.data + t_mh * t_a.ld, t_a.ld}, a22 {a21.data + t_kh, t_a.ld};
+		ConstBlock b11 = t_b, b12 {t_b.data + t_nh, t_b.ld}, b21 {t_b.data + t_kh * t_b.ld, t_b.ld}, b22 {b21.data + t_nh, t_b.ld};
+		Block c11 = t_c, c12 {t_c.data + t_nh, t_c.ld}, c21 {t_c.data + t_mh * t_c.ld, t_c.ld}, c22 {c21.data + t_nh, t_c.ld};
+		Block x {t_work, t_kh}, y {x.data + std::size_t(t_mh) * t_kh, t_nh}, z {y.data + std::size_t(t_kh) * t_nh, t_nh};
+		value_type* work = z.data + std::size_t(t_mh) * t_nh;
+		auto product = [&] (ConstBlock t_left, ConstBlock t_right, Block t_into) {
+			recurse(t_mh, t_nh, t_kh, t_left, t_right, t_into, t_crossover, work, false);
+		};
+
+		combine(t_mh, t_kh, a11, -1, a21, x);		// S3 = A11 - A21
+		combine(t_kh, t_nh, b22, -1, b12, y);		// T3 = B22 - B12
+		product(x, y, c21);							// P7 = S3 T3
+		combine(t_mh, t_kh, a21, 1, a22, x);		// S1 = A21 + A22
+		combine(t_kh, t_nh, b12, -1, b11, y);		// T1 = B12 - B11
+		product(x, y, c22);							// P5 = S1 T1
+		combine(t_mh, t_kh, x, -1, a11, x);			// S2 = S1 - A11
+		combine(t_kh, t_nh, b22, -1, y, y);			// T2 = B22 - T1
+		product(x, y, c12);							// P6 = S2 T2
+		combine(t_mh, t_kh, a12, -1, x, x);			// S4 = A12 - S2
+		product(x, b22, c11);						// P3 = S4 B22
+		product(a11, b11, z);						// P1 = A11 B11
+		combine(t_mh, t_nh, c12, 1, z, c12);		// U2 = P1 + P6
+		combine(t_mh, t_nh, c21, 1, c12, c21);		// U3 = U2 + P7
+		combine(t_mh, t_nh, c12, 1, c22, c12);		// U4 = U2 + P5
+		combine(t_mh, t_nh, c22, 1, c21, c22);		// C22 = U7 = U3 + P5
+		combine(t_mh, t_nh, c12, 1, c11, c12);		// C12 = U5 = U4 + P3
+		combine(t_kh, t_nh, y, -1, b21, y);			// T4 = T2 - B21
+		product(a22, y, c11);						// P4 = A22 T4
+		combine(t_mh, t_nh, c21, -1, c11, c21);		// C21 = U6 = U3 - P4
+		product(a12, b21, c11);						// P2 = A12 B21
+		combine(t_mh, t_nh, c11, 1, z, c11);		// C11 = U1 = P1 + P2
+	}
+
+	// the even part of one level with every operand of the 7 block products formed first, so they can run at once
+	void parallelLevel (length_type t_mh, length_type t_nh, length_type t_kh, ConstBlock t_a, ConstBlock t_b, Block t_c,
+			length_type t_crossover, value_type* t_work) {
+		ConstBlock a11 = t_a, a12 {t_a.data + t_kh, t_a.ld}, a21 {t_a.data + t_mh * t_a.ld, t_a.ld}, a22 {a21.data + t_kh, t_a.ld};
+		ConstBlock b11 = t_b, b12 {t_b.data + t_nh, t_b.ld}, b21 {t_b.data + t_kh * t_b.ld, t_b.ld}, b22 {b21.data + t_nh, t_b.ld};
+		Block c11 = t_c, c12 {t_c.data + t_nh, t_c.ld}, c21 {t_c.data + t_mh * t_c.ld, t_c.ld}, c22 {c21.data + t_nh, t_c.ld};
+		std::size_t a_cells = std::size_t(t_mh) * t_kh, b_cells = std::size_t(t_kh) * t_nh, c_cells = std::size_t(t_mh) * t_nh;
+		value_type* work = t_work;
+		auto take = [&work] (std::size_t t_cells, std::size_t t_ld) { Block res {work, t_ld}; work += t_cells; return res; };
+		Block s1 = take(a_cells, t_kh), s2 = take(a_cells, t_kh), s3 = take(a_cells, t_kh), s4 = take(a_cells, t_kh);
+		Block t1 = take(b_cells, t_nh), t2 = take(b_cells, t_nh), t3 = take(b_cells, t_nh), t4 = take(b_cells, t_nh);
+		Block p2 = take(c_cells, t_nh), p3 = take(c_cells, t_nh), p4 = take(c_cells, t_nh);
+
+		combine(t_mh, t_kh, a21, 1, a22, s1);		// S1 = A21 + A22
+		combine(t_mh, t_kh, s1, -1, a11, s2);		// S2 = S1 - A11
+		combine(t_mh, t_kh, a11, -1, a21, s3);		// S3 = A11 - A21
+		combine(t_mh, t_kh, a12, -1, s2, s4);		// S4 = A12 - S2
+		combine(t_kh, t_nh, b12, -1, b11, t1);		// T1 = B12 - B11
+		combine(t_kh, t_nh, b22, -1, t1, t2);		// T2 = B22 - T1
+		combine(t_kh, t_nh, b22, -1, b12, t3);		// T3 = B22 - B12
+		combine(t_kh, t_nh, t2, -1, b21, t4);		// T4 = T2 - B21
+
+		struct Product { ConstBlock left, right; Block into; };
+		const Product products[7] = {
+			{a11, b11, c11}, {a12, b21, p2}, {s4, b22, p3}, {a22, t4, p4}, {s1, t1, c22}, {s2, t2, c12}, {s3, t3, c21}
+		};
+		std::size_t sub_work = sequentialWorkspace(t_mh, t_nh, t_kh, t_crossover);
+		ThreadPool::instance().parallelFor(0, 7, 1, [&] (std::size_t t_first, std::size_t t_last) {
+			for (std::size_t p = t_first; p < t_last; p++)
+				recurse(t_mh, t_nh, t_kh, products[p].left, products[p].right, products[p].into, t_crossover,
+						work + p * sub_work, false);
+		});
+
+		combine(t_mh, t_nh, c12, 1, c11, c12);		// U2 = P1 + P6
+		combine(t_mh, t_nh, c21, 1, c12, c21);		// U3 = U2 + P7
+		combine(t_mh, t_nh, c12, 1, c22, c12);		// U4 = U2 + P5
+		combine(t_mh, t_nh, c22, 1, c21, c22);		// C22 = U7 = U3 + P5
+		combine(t_mh, t_nh, c12, 1, p3, c12);		// C12 = U5 = U4 + P3
+		combine(t_mh, t_nh, c21, -1, p4, c21);		// C21 = U6 = U3 - P4
+		combine(t_mh, t_nh, c11, 1, p2, c11);		// C11 = U1 = P1 + P2
+	}
+
+	void recurse (length_type t_m, length_type t_n, length_type t_k, ConstBlock t_a, ConstBlock t_b, Block t_c,
+			length_type t_crossover, value_type* t_work, bool t_parallel) {
+		if (leaf(t_m, t_n, t_k, t_crossover)) {
+			gemm(t_m, t_n, t_k, value_type(1), t_a.data, t_a.ld, t_b.data, t_b.ld, value_type(0), t_c.data, t_c.ld);
+			return;
+		}
+		length_type mh = t_m / 2, nh = t_n / 2, kh = t_k / 2;
+		if (t_parallel) parallelLevel(mh, nh, kh, t_a, t_b, t_c, t_crossover, t_work);
+		else sequentialLevel(mh, nh, kh, t_a, t_b, t_c, t_crossover, t_work);
+
+		// odd sides left out of the 2 x 2 split: last inner index, then last row and last column of C
+		if (t_k % 2)
+			gemm(2 * mh, 2 * nh, 1, value_type(1), t_a.data + 2 * kh, t_a.ld, t_b.data + 2 * kh * t_b.ld, t_b.ld,
+					value_type(1), t_c.data, t_c.ld);
+		if (t_m % 2)
+			gemm(1, t_n, t_k, value_type(1), t_a.data + 2 * mh * t_a.ld, t_a.ld, t_b.data, t_b.ld,
+					value_type(0), t_c.data + 2 * mh * t_c.ld, t_c.ld);
+		if (t_n % 2)
+			gemm(2 * mh, 1, t_k, value_type(1), t_a.data, t_a.ld, t_b.data + 2 * nh, t_b.ld,
+					value_type(0), t_c.data + 2 * nh, t_c.ld);
+	}
+}
+
+void detail::strassen (length_type t_m, length_type t_n, length_type t_k, const value_type* t_a, std::size_t t_lda,
+		const value_type* t_b, std::size_t t_ldb, value_type* t_c, std::size_t t_ldc, length_type t_crossover) {
+	if (leaf(t_m, t_n, t_k, t_crossover)) {
+		gemm(t_m, t_n, t_k, value_type(1), t_a, t_lda, t_b, t_ldb, value_type(0), t_c, t_ldc);
+		return;
+	}
+	bool parallel = ThreadPool::instance().size() > 1;
+	Workspace work(parallel ? parallelWorkspace(t_m, t_n, t_k, t_crossover) : sequentialWorkspace(t_m, t_n, t_k, t_crossover));
+	recurse(t_m, t_n, t_k, {t_a, t_lda}, {t_b, t_ldb}, {t_c, t_ldc}, t_crossover, work.data(), parallel);
+}
@@ -0,0 +1,23 @@
+#ifndef MATRIX_STRASSEN_CRYPT_10_10
+#define MATRIX_STRASSEN_CRYPT_10_10
+
+#include <cstddef>
+#include "matrix.h"
+
+namespace m {
+	namespace detail {
+
+		/* C = A * B, where A is t_m x t_k and B is t_k x t_n, all row-major, by the Strassen-Winograd
+		  recursion: each level splits the operands in 2 x 2 blocks and forms the product from 7 block
+		  products and 15 block additions instead of 8 products. A block is handed to gemm once one of its
+		  sides is t_crossover or less; a last odd row, column or inner index is peeled off and added with
+		  gemm. With more than one thread in the pool the 7 products of the first level run concurrently.
+		  Scratch cells come from a workspace kept between calls: about (m k + k n + m n) / 3 of them on
+		  one thread, and about (m k + k n + m n) * 1.5 with the first level run in parallel. */
+		void strassen (Matrix::length_type t_m, Matrix::length_type t_n, Matrix::length_type t_k,
+				const Matrix::value_type* t_a, std::size_t t_lda, const Matrix::value_type* t_b, std::size_t t_ldb,
+				Matrix::value_type* t_c, std::size_t t_ldc, Matrix::length_type t_crossover);
+	}
+}
+
+#endif
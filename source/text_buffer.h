@@ -0,0 +1,72 @@
+#ifndef MATRIX_TEXT_BUFFER_CRYPT_10_10
+#define MATRIX_TEXT_BUFFER_CRYPT_10_10
+
+#include <charconv>
+#include <cstddef>
+#include <ostream>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace m {
+	namespace detail {
+
+		/* collects formatted text in a block of memory and hands it to t_stream a block at a time, instead of
+		  going through the stream (and its locale) once per number. Numbers are formatted by std::to_chars,
+		  which does not depend on the locale; scientific(v, p) gives the same text as
+		  std::cout << std::scientific << std::setprecision(p) << v. Whatever is left is written on destruction. */
+		class TextBuffer {
+			public:
+				explicit TextBuffer (std::ostream& t_stream) : m_stream(t_stream), m_buffer(capacity) {}
+				TextBuffer (const TextBuffer&) = delete;
+				TextBuffer& operator= (const TextBuffer&) = delete;
+				~TextBuffer () { flush(); }
+
+				void put (char t_char) {
+					if (m_used == capacity) flush();
+					m_buffer[m_used++] = t_char;
+				}
+
+				void put (std::string_view t_text) {
+					if (capacity - m_used < t_text.size()) flush();
+					if (t_text.size() > capacity) { m_stream.write(t_text.data(), std::streamsize(t_text.size())); return; }
+					t_text.copy(m_buffer.data() + m_used, t_text.size());
+					m_used += t_text.size();
+				}
+
+				// writes t_value in scientific notation with t_precision digits after the point
+				void scientific (float t_value, int t_precision) {
+					if (t_precision < 0) t_precision = 6;		// as streams do
+					if (t_precision > max_precision) t_precision = max_precision;
+					if (capacity - m_used < number_room) flush();
+					auto result = std::to_chars(m_buffer.data() + m_used, m_buffer.data() + capacity, t_value,
+							std::chars_format::scientific, t_precision);
+					m_used = std::size_t(result.ptr - m_buffer.data());
+				}
+
+				// writes t_value in decimal
+				void integer (std::size_t t_value) {
+					if (capacity - m_used < number_room) flush();
+					auto result = std::to_chars(m_buffer.data() + m_used, m_buffer.data() + capacity, t_value);
+					m_used = std::size_t(result.ptr - m_buffer.data());
+				}
+
+				// hands everything collected so far to the stream
+				void flush () {
+					if (m_used) m_stream.write(m_buffer.data(), std::streamsize(m_used));
+					m_used = 0;
+				}
+
+			private:
+				static constexpr std::size_t capacity = std::size_t(1) << 16;
+				static constexpr int max_precision = 100;
+				static constexpr std::size_t number_room = 128;		// more than a float at max_precision takes
+
+				std::ostream& m_stream;
+				std::vector<char> m_buffer;
+				std::size_t m_used {0};
+		};
+	}
+}
+
+#endif
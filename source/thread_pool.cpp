@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <exception>
+#include "thread_pool.h"
+
+using namespace m::detail;
+
+namespace {
+	thread_local int tl_worker_index = -1;	// index of the pool worker running on this thread, -1 elsewhere
+}
+
+ThreadPool& ThreadPool::instance () {
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool::ThreadPool () {
+	unsigned hardware = std::thread::hardware_concurrency();
+	m_size = hardware == 0 ? 1 : hardware;
+}
+
+ThreadPool::~ThreadPool () {
+	m_stopWorkers();
+}
+
+void ThreadPool::resize (unsigned t_threads) {
+	if (t_threads == 0) {
+		t_threads = std::thread::hardware_concurrency();
+		if (t_threads == 0) t_threads = 1;
+	}
+	std::lock_guard<std::mutex> lock(m_resize_mutex);
+	if (m_started && t_threads == m_size) return;
+	m_stopWorkers();
+	m_size = t_threads;
+	m_start(t_threads);
+}
+
+unsigned ThreadPool::size () const {
+	return m_size;
+}
+
+void ThreadPool::submit (task_type t_task) {
+	m_ensureStarted();
+	if (m_queues.empty()) { t_task(); return; }	// single-threaded pool: nobody else would run it
+	std::size_t target = tl_worker_index >= 0 ? std::size_t(tl_worker_index)
+		: m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+	{	// counted before it is visible, so m_pending never drops below the number of queued tasks
+		std::lock_guard<std::mutex> lock(m_sleep_mutex);
+		m_pending++;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_queues[target]->mutex);
+		m_queues[target]->tasks.push_back(std::move(t_task));
+	}
+	m_wake.notify_one();
+}
+
+bool ThreadPool::runPending () {
+	task_type task;
+	if (!m_take(tl_worker_index, task)) return false;
+	task();
+	return true;
+}
+
+void ThreadPool::parallelFor (std::size_t t_begin, std::size_t t_end, std::size_t t_grain, const range_body& t_body) {
+	if (t_end <= t_begin) return;
+	std::size_t count = t_end - t_begin;
+	if (t_grain == 0) t_grain = 1;
+	if (m_size <= 1 || count <= t_grain) { t_body(t_begin, t_end); return; }
+
+	// a few chunks per thread so faster threads pick up the slack
+	std::size_t chunks = std::min((count + t_grain - 1) / t_grain, std::size_t(m_size) * 4);
+	std::size_t chunk = (count + chunks - 1) / chunks;
+	chunks = (count + chunk - 1) / chunk;
+
+	struct State {
+		std::atomic<std::size_t> next {0}, done {0};
+		std::mutex error_mutex {};
+		std::exception_ptr error {};
+	};
+	auto state = std::make_shared<State>();
+	auto work = [state, &t_body, t_begin, t_end, chunk, chunks] {
+		for (std::size_t c; (c = state->next.fetch_add(1)) < chunks; ) {
+			try { t_body(t_begin + c * chunk, std::min(t_end, t_begin + (c + 1) * chunk)); }
+			catch (...) {
+				std::lock_guard<std::mutex> lock(state->error_mutex);
+				if (!state->error) state->error = std::current_exception();
+			}
+			state->done.fetch_add(1, std::memory_order_release);
+		}
+	};
+
+	unsigned helpers = unsigned(std::min<std::size_t>(m_size, chunks)) - 1;
+	for (unsigned i = 0; i < helpers; i++) submit(work);
+	work();
+	while (state->done.load(std::memory_order_acquire) < chunks)
+		if (!runPending()) std::this_thread::yield();
+	if (state->error) std::rethrow_exception(state->error);
+}
+
+void ThreadPool::m_ensureStarted () {
+	if (m_started.load(std::memory_order_acquire)) return;
+	std::lock_guard<std::mutex> lock(m_resize_mutex);
+	if (!m_started.load()) m_start(m_size);
+}
+
+void ThreadPool::m_start (unsigned t_threads) {
+	// the thread that asks for parallel work takes part in it, so one worker fewer is started
+	m_stop = false;
+	m_queues.clear();
+	for (unsigned i = 0; i + 1 < t_threads; i++)
+		m_queues.push_back(std::make_unique<Queue>());
+	for (unsigned i = 0; i + 1 < t_threads; i++)
+		m_workers.emplace_back(&ThreadPool::m_workerLoop, this, i);
+	m_started.store(true, std::memory_order_release);
+}
+
+void ThreadPool::m_stopWorkers () {
+	{
+		std::lock_guard<std::mutex> lock(m_sleep_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers) worker.join();
+	m_workers.clear();
+	// whatever is still queued is run here rather than dropped
+	task_type task;
+	while (m_take(-1, task)) task();
+	m_started = false;
+}
+
+bool ThreadPool::m_take (int t_home, task_type& t_task) {
+	std::size_t count = m_queues.size();
+	if (count == 0 || m_pending.load() == 0) return false;
+	if (t_home >= 0) {	// own queue first, newest task (its data is likely still in cache)
+		Queue& own = *m_queues[std::size_t(t_home)];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			t_task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			m_pending--;
+			return true;
+		}
+	}
+	std::size_t start = t_home >= 0 ? std::size_t(t_home) + 1 : 0;
+	for (std::size_t i = 0; i < count; i++) {	// steal the oldest task of someone else
+		Queue& victim = *m_queues[(start + i) % count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.tasks.empty()) continue;
+		t_task = std::move(victim.tasks.front());
+		victim.tasks.pop_front();
+		m_pending--;
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::m_workerLoop (unsigned t_index) {
+	tl_worker_index = int(t_index);
+	task_type task;
+	while (true) {
+		if (m_take(int(t_index), task)) {
+			task();
+			task = nullptr;
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_sleep_mutex);
+		m_wake.wait(lock, [this] { return m_stop || m_pending.load() > 0; });
+		if (m_stop && m_pending.load() == 0) return;
+	}
+}
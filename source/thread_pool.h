@@ -0,0 +1,76 @@
+#ifndef MATRIX_THREAD_POOL_CRYPT_10_10
+#define MATRIX_THREAD_POOL_CRYPT_10_10
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace m {
+	namespace detail {
+
+		/* work-stealing pool shared by the whole library. Every worker owns a deque: it takes its own
+		  tasks from the back and steals from the front of the others' deques when it runs dry.
+		  Threads waiting on parallel work keep running queued tasks, so nested use cannot deadlock. */
+		class ThreadPool {
+			public:
+				using task_type = std::function<void ()>;
+				using range_body = std::function<void (std::size_t t_begin, std::size_t t_end)>;
+
+				// returns the library pool (workers are started on first use)
+				static ThreadPool& instance ();
+
+				/* sets the number of threads taking part in parallel work, the calling thread included
+				  (0 picks the hardware concurrency). Must not be called while work is running. */
+				void resize (unsigned t_threads);
+
+				// returns the number of threads taking part in parallel work, the calling thread included
+				unsigned size () const;
+
+				// queues t_task to run on some worker
+				void submit (task_type t_task);
+
+				// runs one queued task on the calling thread, returns false if there was none
+				bool runPending ();
+
+				/* calls t_body on chunks of [t_begin, t_end) of at least t_grain indices across the pool and
+				  returns once all of them are done. Ranges of t_grain or less run inline on the caller.
+				  The first exception thrown by t_body is rethrown here. */
+				void parallelFor (std::size_t t_begin, std::size_t t_end, std::size_t t_grain, const range_body& t_body);
+
+				ThreadPool (const ThreadPool&) = delete;
+				ThreadPool& operator= (const ThreadPool&) = delete;
+				~ThreadPool ();
+			private:
+				struct Queue {
+					std::mutex mutex {};
+					std::deque<task_type> tasks {};
+				};
+
+				std::vector<std::unique_ptr<Queue>> m_queues {};	// one per worker
+				std::vector<std::thread> m_workers {};
+				std::mutex m_sleep_mutex {};
+				std::condition_variable m_wake {};
+				std::atomic<std::size_t> m_pending {0};				// tasks pushed and not yet taken
+				std::atomic<unsigned> m_next_queue {0};				// round-robin target for external submits
+				std::mutex m_resize_mutex {};
+				unsigned m_size {0};
+				bool m_stop {false};
+				std::atomic<bool> m_started {false};
+
+				ThreadPool ();
+				void m_ensureStarted ();
+				void m_start (unsigned t_threads);
+				void m_stopWorkers ();
+				bool m_take (int t_home, task_type& t_task);
+				void m_workerLoop (unsigned t_index);
+		};
+	}
+}
+
+#endif
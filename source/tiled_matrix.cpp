@@ -0,0 +1,645 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <initializer_list>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "tiled_matrix.h"
+#include "matrix_file.h"
+#include "lu.h"
+#include "gemm.h"
+#include "thread_pool.h"
+
+using namespace m;
+
+namespace {
+	using value_type = Matrix::value_type;
+	using length_type = Matrix::length_type;
+
+	constexpr length_type BLOCK = 64;		// columns of the panels factored within a tile column, as LU does
+
+	// tiles live on the heap whatever resource is current where they are read, as they outlive the call
+	std::pmr::memory_resource* tileResource () {
+		return std::pmr::new_delete_resource();
+	}
+
+	/* a tile holding the cells t_cells looks at. It is filled without a mutable view or data() pointer,
+	  which would keep copies from sharing it (see Matrix), so handing it out stays O(1) */
+	Matrix tileOf (const ConstMatrixView& t_cells) {
+		ResourceScope scope(tileResource());
+		return Matrix(t_cells);
+	}
+
+	std::size_t tileBytes (const Matrix& t_tile) {
+		return std::size_t(t_tile.getRows()) * t_tile.stride() * sizeof(value_type);
+	}
+
+	/* factors the t_rows x t_columns panel t_panel in place with partial pivoting (t_rows >= t_columns),
+	  swapping whole rows of it; t_pivots[j] is the row swapped with row j. Blocked as LU::m_factor is */
+	void factorPanel (Matrix& t_panel, std::vector<length_type>& t_pivots) {
+		length_type rows = t_panel.getRows(), columns = t_panel.getColumns();
+		value_type* a = detail::writableView(t_panel).data();
+		std::size_t lda = t_panel.stride();
+		t_pivots.resize(columns);
+
+		for (length_type k0 = 0; k0 < columns; k0 += BLOCK) {
+			length_type k1 = std::min(columns, k0 + BLOCK);
+
+			for (length_type j = k0; j < k1; j++) {
+				length_type pivot = j;
+				value_type largest = std::fabs(a[j * lda + j]);
+				for (length_type i = j + 1; i < rows; i++)
+					if (std::fabs(a[i * lda + j]) > largest) { largest = std::fabs(a[i * lda + j]); pivot = i; }
+				t_pivots[j] = pivot;
+				if (largest == value_type(0)) continue;		// column already eliminated
+				if (pivot != j) std::swap_ranges(a + j * lda, a + j * lda + columns, a + pivot * lda);
+				const value_type* pivot_row = a + j * lda;
+				for (length_type i = j + 1; i < rows; i++) {
+					value_type* row = a + i * lda;
+					value_type multiple = row[j] /= pivot_row[j];
+					for (length_type c = j + 1; c < k1; c++)
+						row[c] -= multiple * pivot_row[c];
+				}
+			}
+			if (k1 == columns) break;
+
+			// U12 = L11^-1 * A12, then A22 -= L21 * U12
+			MatrixView panel = detail::writableView(t_panel);
+			solveLower(panel.view(k0, k0, k1 - 1, k1 - 1), panel.view(k0, k1, k1 - 1, columns - 1), true);
+			if (k1 < rows)
+				detail::gemm(rows - k1, columns - k1, k1 - k0, value_type(-1), a + k1 * lda + k0, lda,
+						a + k0 * lda + k1, lda, value_type(1), a + k1 * lda + k1, lda);
+		}
+	}
+
+	// swaps rows of t_cells as t_pivots say, t_pivots[i] holding the row of the matrix swapped with row t_first + i
+	void swapRows (Matrix& t_cells, const length_type* t_pivots, length_type t_first, length_type t_count) {
+		value_type* a = detail::writableView(t_cells).data();
+		std::size_t lda = t_cells.stride();
+		for (length_type i = 0; i < t_count; i++) {
+			length_type pivot = t_pivots[i] - t_first;
+			if (pivot != i) std::swap_ranges(a + i * lda, a + i * lda + t_cells.getColumns(), a + pivot * lda);
+		}
+	}
+}
+
+/* the file of a tiled matrix and the cache of its tiles. Entries of tiles being read have no cells yet;
+  they aren't in m_recent, so nothing evicts them, and whoever wants them waits for the read to end */
+class detail::TileStore : public std::enable_shared_from_this<TileStore> {
+	public:
+		const length_type rows, columns, tile;
+		const length_type tile_rows, tile_columns;		// tiles down and across
+
+		TileStore (int t_file, length_type t_rows, length_type t_columns, length_type t_tile,
+				std::size_t t_payload, std::size_t t_budget)
+			: rows(t_rows), columns(t_columns), tile(t_tile),
+			  tile_rows((t_rows + t_tile - 1) / t_tile), tile_columns((t_columns + t_tile - 1) / t_tile),
+			  m_file(t_file), m_payload(t_payload), m_budget(t_budget) {}
+		TileStore (const TileStore&) = delete;
+		TileStore& operator= (const TileStore&) = delete;
+
+		~TileStore () {
+			try { flush(); }
+			catch (...) {}
+			::close(m_file);
+		}
+
+		length_type rowsOf (length_type t_i) const { return std::min(tile, rows - t_i * tile); }
+		length_type columnsOf (length_type t_j) const { return std::min(tile, columns - t_j * tile); }
+		std::size_t key (length_type t_i, length_type t_j) const { return std::size_t(t_i) * tile_columns + t_j; }
+
+		// whether t_status is that of the file of this matrix
+		bool isFile (const struct stat& t_status) const {
+			struct stat status;
+			return ::fstat(m_file, &status) == 0 && status.st_dev == t_status.st_dev && status.st_ino == t_status.st_ino;
+		}
+
+		std::size_t getBudget () const {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_budget;
+		}
+		void setBudget (std::size_t t_budget) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_budget = t_budget;
+			m_evict(0);
+		}
+
+		Matrix get (std::size_t t_key) {
+			std::unique_lock<std::mutex> lock(m_mutex);
+			return *m_acquire(t_key, lock).cells;
+		}
+
+		void put (std::size_t t_key, Matrix t_cells) {
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_settle(t_key, lock);
+			auto found = m_entries.find(t_key);
+			if (found != m_entries.end()) {		// replaced, so never written back
+				m_used -= tileBytes(*found->second.cells);
+				m_recent.erase(found->second.place);
+				m_entries.erase(found);
+			}
+			std::size_t bytes = tileBytes(t_cells);
+			m_evict(bytes);
+			Entry& entry = m_entries[t_key];
+			entry.cells.emplace(std::move(t_cells));
+			entry.dirty = true;
+			m_recent.push_front(t_key);
+			entry.place = m_recent.begin();
+			m_used += bytes;
+		}
+
+		// calls t_change(cells) on the cached tile under the lock, so it should be quick
+		template <class F>
+		void update (std::size_t t_key, F&& t_change) {
+			std::unique_lock<std::mutex> lock(m_mutex);
+			Entry& entry = m_acquire(t_key, lock);
+			t_change(*entry.cells);
+			entry.dirty = true;
+		}
+
+		void prefetch (std::size_t t_key) {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_entries.count(t_key)) return;
+				m_entries[t_key];		// being read
+			}
+			std::shared_ptr<TileStore> store = shared_from_this();
+			ThreadPool::instance().submit([store, t_key] {
+				std::unique_lock<std::mutex> lock(store->m_mutex);
+				try { store->m_load(t_key, lock); }
+				catch (...) {}		// the entry is gone, so whoever wants the tile reads it again and sees the error
+			});
+		}
+
+		void flush () {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (auto& [key, entry] : m_entries)
+				if (entry.cells && entry.dirty) {
+					m_write(key, *entry.cells);
+					entry.dirty = false;
+				}
+		}
+
+	private:
+		struct Entry {
+			std::optional<Matrix> cells {};						// empty while being read
+			bool dirty {false};									// changed since read
+			std::list<std::size_t>::iterator place {};			// in m_recent once read
+		};
+
+		int m_file;
+		std::size_t m_payload;							// byte offset of the first slot
+		mutable std::mutex m_mutex {};
+		std::condition_variable m_loaded {};			// an entry got its cells, or was dropped
+		std::unordered_map<std::size_t, Entry> m_entries {};
+		std::list<std::size_t> m_recent {};			// keys of cached tiles, most recently used first
+		std::size_t m_used {0};						// bytes of cached tiles
+		std::size_t m_budget;
+
+		std::size_t m_offset (std::size_t t_key) const {
+			return m_payload + t_key * std::size_t(tile) * tile * sizeof(value_type);
+		}
+
+		Matrix m_read (std::size_t t_key) const {
+			length_type i = length_type(t_key / tile_columns), j = length_type(t_key % tile_columns);
+			length_type height = rowsOf(i), width = columnsOf(j);
+			std::vector<value_type> cells(std::size_t(height) * width);
+			char* bytes = reinterpret_cast<char*>(cells.data());
+			std::size_t size = cells.size() * sizeof(value_type), done = 0;
+			while (done < size) {
+				ssize_t got = ::pread(m_file, bytes + done, size - done, off_t(m_offset(t_key) + done));
+				if (got == 0) throw ("Matrix file is truncated!");
+				if (got < 0) throw ("Couldn't read tile!");
+				done += std::size_t(got);
+			}
+			return tileOf(ConstMatrixView(cells.data(), height, width, width));
+		}
+
+		void m_write (std::size_t t_key, const Matrix& t_cells) const {
+			std::size_t row_bytes = std::size_t(t_cells.getColumns()) * sizeof(value_type);
+			std::vector<char> bytes(row_bytes * t_cells.getRows());
+			const value_type* cells = t_cells.data();
+			for (length_type r = 0; r < t_cells.getRows(); r++)
+				std::memcpy(bytes.data() + r * row_bytes, cells + r * t_cells.stride(), row_bytes);
+			std::size_t done = 0;
+			while (done < bytes.size()) {
+				ssize_t put = ::pwrite(m_file, bytes.data() + done, bytes.size() - done, off_t(m_offset(t_key) + done));
+				if (put <= 0) throw ("Couldn't write tile!");
+				done += std::size_t(put);
+			}
+		}
+
+		// returns once tile t_key isn't being read; a pool task may be reading it, so queued tasks are run meanwhile
+		void m_settle (std::size_t t_key, std::unique_lock<std::mutex>& t_lock) {
+			ThreadPool& pool = ThreadPool::instance();
+			while (true) {
+				auto found = m_entries.find(t_key);
+				if (found == m_entries.end() || found->second.cells) return;
+				t_lock.unlock();
+				bool ran = pool.runPending();
+				t_lock.lock();
+				if (!ran) m_loaded.wait_for(t_lock, std::chrono::milliseconds(1));
+			}
+		}
+
+		// returns the entry of tile t_key, reading it first if it isn't cached, as the most recently used
+		Entry& m_acquire (std::size_t t_key, std::unique_lock<std::mutex>& t_lock) {
+			m_settle(t_key, t_lock);
+			auto found = m_entries.find(t_key);
+			if (found == m_entries.end()) {
+				m_entries[t_key];
+				return m_load(t_key, t_lock);
+			}
+			m_recent.splice(m_recent.begin(), m_recent, found->second.place);
+			return found->second;
+		}
+
+		// reads tile t_key, whose entry was made empty by the caller, without holding t_lock meanwhile
+		Entry& m_load (std::size_t t_key, std::unique_lock<std::mutex>& t_lock) {
+			t_lock.unlock();
+			std::optional<Matrix> cells;
+			try { cells.emplace(m_read(t_key)); }
+			catch (...) {
+				t_lock.lock();
+				m_entries.erase(t_key);
+				m_loaded.notify_all();
+				throw;
+			}
+			t_lock.lock();
+			std::size_t bytes = tileBytes(*cells);
+			try { m_evict(bytes); }
+			catch (...) {
+				m_entries.erase(t_key);
+				m_loaded.notify_all();
+				throw;
+			}
+			Entry& entry = m_entries[t_key];
+			entry.cells = std::move(cells);
+			m_recent.push_front(t_key);
+			entry.place = m_recent.begin();
+			m_used += bytes;
+			m_loaded.notify_all();
+			return entry;
+		}
+
+		// drops least recently used tiles, written back if changed, until t_room more bytes fit in the budget
+		void m_evict (std::size_t t_room) {
+			while (!m_recent.empty() && m_used + t_room > m_budget) {
+				std::size_t key = m_recent.back();
+				Entry& entry = m_entries.find(key)->second;
+				if (entry.dirty) m_write(key, *entry.cells);
+				m_used -= tileBytes(*entry.cells);
+				m_recent.pop_back();
+				m_entries.erase(key);
+			}
+		}
+};
+
+namespace {
+	/* makes the file of a new zero tiled matrix and returns its store; the file is emptied only once it is
+	  known not to be that of one of t_operands, which the new matrix is computed from */
+	std::shared_ptr<detail::TileStore> createStore (const std::string& t_path, length_type t_rows, length_type t_columns,
+			length_type t_tile, std::size_t t_budget, std::initializer_list<const detail::TileStore*> t_operands = {}) {
+		if (t_rows == 0 || t_columns == 0 || t_tile == 0) throw ("Number of rows and columns must be positive!");
+		int file = ::open(t_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (file < 0) throw ("Couldn't create matrix file!");
+		struct stat status;
+		if (::fstat(file, &status) != 0) {
+			::close(file);
+			throw ("Couldn't create matrix file!");
+		}
+		for (const detail::TileStore* operand : t_operands)
+			if (operand->isFile(status)) {
+				::close(file);
+				throw ("Result can't be written over an operand!");
+			}
+		if (::ftruncate(file, 0) != 0) {
+			::close(file);
+			throw ("Couldn't create matrix file!");
+		}
+
+		detail::TiledFileHeader header {};
+		std::memcpy(header.magic, detail::tiled_file_magic, sizeof(header.magic));
+		header.version = detail::file_version;
+		header.byte_order = detail::file_byte_order;
+		header.dtype = detail::file_dtype_float32;
+		header.rows = t_rows;
+		header.columns = t_columns;
+		header.tile = t_tile;
+		header.payload = (sizeof(header) + detail::file_alignment - 1) / detail::file_alignment * detail::file_alignment;
+		std::size_t slots = std::size_t((t_rows + t_tile - 1) / t_tile) * ((t_columns + t_tile - 1) / t_tile);
+		std::size_t size = header.payload + slots * t_tile * t_tile * sizeof(value_type);
+
+		// the slots are left to the file system as a hole, which reads as zeros
+		if (::pwrite(file, &header, sizeof(header), 0) != ssize_t(sizeof(header)) || ::ftruncate(file, off_t(size)) != 0) {
+			::close(file);
+			throw ("Couldn't create matrix file!");
+		}
+		return std::make_shared<detail::TileStore>(file, t_rows, t_columns, t_tile, header.payload, t_budget);
+	}
+}
+
+TiledMatrix::TiledMatrix (const std::string& t_path, length_type t_rows, length_type t_columns,
+		length_type t_tile, std::size_t t_budget) : m_store(createStore(t_path, t_rows, t_columns, t_tile, t_budget)) {}
+
+TiledMatrix::TiledMatrix (std::shared_ptr<detail::TileStore> t_store) : m_store(std::move(t_store)) {}
+
+TiledMatrix TiledMatrix::open (const std::string& t_path, std::size_t t_budget) {
+	int file = ::open(t_path.c_str(), O_RDWR | O_CLOEXEC);
+	if (file < 0) throw ("Couldn't open matrix file!");
+	try {
+		detail::TiledFileHeader header;
+		if (::pread(file, &header, sizeof(header), 0) != ssize_t(sizeof(header))
+				|| std::memcmp(header.magic, detail::tiled_file_magic, sizeof(header.magic)) != 0)
+			throw ("Not a tiled matrix file!");
+		if (header.version != detail::file_version || header.byte_order != detail::file_byte_order
+				|| header.dtype != detail::file_dtype_float32)
+			throw ("Unsupported matrix file!");
+		if (header.rows == 0 || header.columns == 0 || header.tile == 0) throw ("Number of rows and columns must be positive!");
+		if (header.payload < sizeof(header) || header.payload % detail::file_alignment != 0) throw ("Not a tiled matrix file!");
+		return TiledMatrix(std::make_shared<detail::TileStore>(file, header.rows, header.columns, header.tile,
+				std::size_t(header.payload), t_budget));
+	} catch (...) {
+		::close(file);
+		throw;
+	}
+}
+
+TiledMatrix TiledMatrix::store (const Matrix& t_matrix, const std::string& t_path, length_type t_tile, std::size_t t_budget) {
+	TiledMatrix res(t_path, t_matrix.getRows(), t_matrix.getColumns(), t_tile, t_budget);
+	res.write(0, 0, t_matrix);
+	res.flush();
+	return res;
+}
+
+TiledMatrix::TiledMatrix (TiledMatrix&& t_matrix) noexcept = default;
+TiledMatrix& TiledMatrix::operator= (TiledMatrix&& t_matrix) noexcept = default;
+TiledMatrix::~TiledMatrix () = default;
+
+TiledMatrix::length_type TiledMatrix::getRows () const { return m_store->rows; }
+TiledMatrix::length_type TiledMatrix::getColumns () const { return m_store->columns; }
+TiledMatrix::length_type TiledMatrix::tileSize () const { return m_store->tile; }
+TiledMatrix::length_type TiledMatrix::tileRows () const { return m_store->tile_rows; }
+TiledMatrix::length_type TiledMatrix::tileColumns () const { return m_store->tile_columns; }
+
+std::size_t TiledMatrix::getBudget () const {
+	return m_store->getBudget();
+}
+
+void TiledMatrix::setBudget (std::size_t t_budget) {
+	m_store->setBudget(t_budget);
+}
+
+Matrix TiledMatrix::tile (length_type t_i, length_type t_j) const {
+	if (t_i >= tileRows() || t_j >= tileColumns()) throw ("Indices are out of bound!");
+	return m_store->get(m_store->key(t_i, t_j));
+}
+
+void TiledMatrix::setTile (length_type t_i, length_type t_j, const Matrix& t_tile) {
+	if (t_i >= tileRows() || t_j >= tileColumns()) throw ("Indices are out of bound!");
+	if (t_tile.getRows() != m_store->rowsOf(t_i) || t_tile.getColumns() != m_store->columnsOf(t_j))
+		throw ("Dimensions of tile don't match!");
+	m_store->put(m_store->key(t_i, t_j), Matrix(t_tile, tileResource()));
+}
+
+void TiledMatrix::prefetch (length_type t_i, length_type t_j) const {
+	if (t_i >= tileRows() || t_j >= tileColumns()) throw ("Indices are out of bound!");
+	m_store->prefetch(m_store->key(t_i, t_j));
+}
+
+Matrix TiledMatrix::read (length_type t_i0, length_type t_j0, length_type t_i1, length_type t_j1) const {
+	if (t_i0 > t_i1 || t_j0 > t_j1) throw("Number of rows and columns of submatrix must be positive!");
+	if (t_i1 >= getRows() || t_j1 >= getColumns()) throw("Rows and Columns of submatrix must be contained in the main matrix!");
+	length_type size = tileSize();
+	Matrix res(t_i1 - t_i0 + 1, t_j1 - t_j0 + 1);
+	value_type* out = detail::writableView(res).data();
+	std::size_t ldo = res.stride();
+	length_type ti0 = t_i0 / size, ti1 = t_i1 / size, tj0 = t_j0 / size, tj1 = t_j1 / size;
+	for (length_type ti = ti0; ti <= ti1; ti++)
+		for (length_type tj = tj0; tj <= tj1; tj++) {
+			if (tj < tj1) prefetch(ti, tj + 1);
+			else if (ti < ti1) prefetch(ti + 1, tj0);
+			const Matrix cells = tile(ti, tj);
+			length_type r0 = std::max(t_i0, ti * size), r1 = std::min(t_i1, ti * size + cells.getRows() - 1);
+			length_type c0 = std::max(t_j0, tj * size), c1 = std::min(t_j1, tj * size + cells.getColumns() - 1);
+			for (length_type r = r0; r <= r1; r++)
+				std::memcpy(out + (r - t_i0) * ldo + (c0 - t_j0), cells.data() + (r - ti * size) * cells.stride() + (c0 - tj * size),
+						std::size_t(c1 - c0 + 1) * sizeof(value_type));
+		}
+	return res;
+}
+
+void TiledMatrix::write (length_type t_i0, length_type t_j0, const Matrix& t_matrix) {
+	if (t_i0 >= getRows() || t_j0 >= getColumns() || t_matrix.getRows() > getRows() - t_i0
+			|| t_matrix.getColumns() > getColumns() - t_j0)
+		throw ("Rows and Columns of submatrix must be contained in the main matrix!");
+	length_type size = tileSize();
+	length_type t_i1 = t_i0 + t_matrix.getRows() - 1, t_j1 = t_j0 + t_matrix.getColumns() - 1;
+	length_type ti0 = t_i0 / size, ti1 = t_i1 / size, tj0 = t_j0 / size, tj1 = t_j1 / size;
+	for (length_type ti = ti0; ti <= ti1; ti++)
+		for (length_type tj = tj0; tj <= tj1; tj++) {
+			length_type rows = m_store->rowsOf(ti), columns = m_store->columnsOf(tj);
+			length_type r0 = std::max(t_i0, ti * size), r1 = std::min(t_i1, ti * size + rows - 1);
+			length_type c0 = std::max(t_j0, tj * size), c1 = std::min(t_j1, tj * size + columns - 1);
+			ConstMatrixView part = t_matrix.view(r0 - t_i0, c0 - t_j0, r1 - t_i0, c1 - t_j0);
+			if (r1 - r0 + 1 == rows && c1 - c0 + 1 == columns) {	// covered whole, so not read first
+				m_store->put(m_store->key(ti, tj), tileOf(part));
+				continue;
+			}
+			// the tile is put together beside the cached one, which copies may hold
+			const Matrix old = tile(ti, tj);
+			std::vector<value_type> cells(std::size_t(rows) * columns);
+			for (length_type r = 0; r < rows; r++)
+				std::memcpy(cells.data() + std::size_t(r) * columns, old.data() + std::size_t(r) * old.stride(),
+						std::size_t(columns) * sizeof(value_type));
+			for (length_type r = r0; r <= r1; r++)
+				std::memcpy(cells.data() + std::size_t(r - ti * size) * columns + (c0 - tj * size), part.data() + (r - r0) * part.stride(),
+						std::size_t(c1 - c0 + 1) * sizeof(value_type));
+			m_store->put(m_store->key(ti, tj), tileOf(ConstMatrixView(cells.data(), rows, columns, columns)));
+		}
+}
+
+TiledMatrix::value_type TiledMatrix::getCell (length_type t_row, length_type t_column) const {
+	if (t_row >= getRows() || t_column >= getColumns()) throw ("Indices are out of bound!");
+	length_type size = tileSize();
+	return tile(t_row / size, t_column / size).getCell(t_row % size, t_column % size);
+}
+
+void TiledMatrix::setCell (length_type t_row, length_type t_column, value_type t_value) {
+	if (t_row >= getRows() || t_column >= getColumns()) throw ("Indices are out of bound!");
+	length_type size = tileSize();
+	m_store->update(m_store->key(t_row / size, t_column / size), [&] (Matrix& t_cells) {
+		t_cells.setCell(t_row % size, t_column % size, t_value);
+	});
+}
+
+void TiledMatrix::flush () const {
+	m_store->flush();
+}
+
+TiledMatrix& TiledMatrix::add (const TiledMatrix& t_matrix) {
+	if (getRows() != t_matrix.getRows() || getColumns() != t_matrix.getColumns()) throw ("Matrices couldn't be added!");
+	if (tileSize() != t_matrix.tileSize()) throw ("Tile sizes don't match!");
+	for (length_type i = 0; i < tileRows(); i++)
+		for (length_type j = 0; j < tileColumns(); j++) {
+			length_type next_i = j + 1 < tileColumns() ? i : i + 1, next_j = j + 1 < tileColumns() ? j + 1 : 0;
+			if (next_i < tileRows()) {
+				prefetch(next_i, next_j);
+				t_matrix.prefetch(next_i, next_j);
+			}
+			const Matrix a = tile(i, j), b = t_matrix.tile(i, j);
+			setTile(i, j, Matrix(a + b));
+		}
+	return *this;
+}
+
+TiledMatrix TiledMatrix::transposed (const std::string& t_path) const {
+	TiledMatrix res(createStore(t_path, getColumns(), getRows(), tileSize(), getBudget(), {m_store.get()}));
+	for (length_type i = 0; i < tileRows(); i++)
+		for (length_type j = 0; j < tileColumns(); j++) {
+			if (j + 1 < tileColumns()) prefetch(i, j + 1);
+			else if (i + 1 < tileRows()) prefetch(i + 1, 0);
+			const Matrix cells = tile(i, j);
+			res.setTile(j, i, Matrix(cells.transposed()));
+		}
+	res.flush();
+	return res;
+}
+
+std::vector<TiledMatrix::length_type> TiledMatrix::factorize () {
+	if (getRows() != getColumns()) throw ("Only square matrices can be factored!");
+	length_type n = getRows(), size = tileSize(), tiles = tileColumns();
+	std::vector<length_type> pivots(n), panel_pivots;
+	// has tile column t_j read from row t_i0 down while the one before it is worked on
+	auto prefetchColumn = [&] (length_type t_j, length_type t_i0) {
+		for (length_type i = t_i0 / size; i < tileRows(); i++)
+			prefetch(i, t_j);
+	};
+
+	for (length_type k = 0; k < tiles; k++) {
+		length_type k0 = k * size, k1 = std::min(n, k0 + size);		// columns [k0, k1) of the panel
+		Matrix panel = read(k0, k0, n - 1, k1 - 1);
+		factorPanel(panel, panel_pivots);
+		for (length_type t = 0; t < k1 - k0; t++)
+			pivots[k0 + t] = k0 + panel_pivots[t];
+		write(k0, k0, panel);
+		if (k + 1 < tiles) prefetchColumn(k + 1, k0);
+
+		// every later tile column gets the swaps, U12 = L11^-1 * A12, and A22 -= L21 * U12
+		const Matrix& factors = panel;
+		for (length_type j = k + 1; j < tiles; j++) {
+			if (j + 1 < tiles) prefetchColumn(j + 1, k0);
+			length_type j0 = j * size, j1 = std::min(n, j0 + size);
+			Matrix column = read(k0, j0, n - 1, j1 - 1);
+			swapRows(column, pivots.data() + k0, k0, k1 - k0);
+			MatrixView cells = detail::writableView(column);
+			solveLower(factors.view(0, 0, k1 - k0 - 1, k1 - k0 - 1), cells.view(0, 0, k1 - k0 - 1, j1 - j0 - 1), true);
+			if (k1 < n)
+				detail::gemm(n - k1, j1 - j0, k1 - k0, value_type(-1), factors.data() + (k1 - k0) * factors.stride(), factors.stride(),
+						cells.data(), column.stride(), value_type(1), cells.data() + (k1 - k0) * column.stride(), column.stride());
+			write(k0, j0, column);
+		}
+	}
+
+	// the L columns of a tile column follow the swaps made after it, as whole rows are swapped in LU
+	for (length_type j = 0; j + 1 < tiles; j++) {
+		if (j + 2 < tiles) prefetchColumn(j + 1, (j + 2) * size);
+		length_type j0 = j * size, r0 = (j + 1) * size;
+		Matrix column = read(r0, j0, n - 1, j0 + size - 1);
+		swapRows(column, pivots.data() + r0, r0, n - r0);
+		write(r0, j0, column);
+	}
+	return pivots;
+}
+
+std::vector<TiledMatrix::value_type> TiledMatrix::solveFactored (const std::vector<length_type>& t_pivots,
+		const std::vector<value_type>& t_b) const {
+	if (getRows() != getColumns() || t_pivots.size() != getRows()) throw ("Size of pivots doesn't match!");
+	if (t_b.size() != getRows()) throw ("Size of right-hand side doesn't match!");
+	length_type n = getRows(), size = tileSize(), tiles = tileRows();
+	std::vector<value_type> x(t_b);
+	for (length_type i = 0; i < n; i++)
+		if (t_pivots[i] != i) std::swap(x[i], x[t_pivots[i]]);
+
+	// L * y = P * b, a row of tiles at a time
+	for (length_type i = 0; i < tiles; i++) {
+		length_type i0 = i * size;
+		for (length_type j = 0; j <= i; j++) {
+			if (j < i) prefetch(i, j + 1);
+			else if (i + 1 < tiles) prefetch(i + 1, 0);
+			const Matrix cells = tile(i, j);
+			const value_type* a = cells.data();
+			length_type j0 = j * size;
+			for (length_type r = 0; r < cells.getRows(); r++) {
+				value_type sum = x[i0 + r];
+				length_type last = j < i ? cells.getColumns() : r;
+				for (length_type c = 0; c < last; c++)
+					sum -= a[r * cells.stride() + c] * x[j0 + c];
+				x[i0 + r] = sum;
+			}
+		}
+	}
+
+	// U * x = y, from the last row of tiles up
+	for (length_type i = tiles; i-- > 0; ) {
+		length_type i0 = i * size;
+		for (length_type j = tiles; j-- > i; ) {
+			if (j > i) prefetch(i, j - 1);
+			else if (i > 0) prefetch(i - 1, tiles - 1);
+			const Matrix cells = tile(i, j);
+			const value_type* a = cells.data();
+			length_type j0 = j * size;
+			for (length_type r = cells.getRows(); r-- > 0; ) {
+				value_type sum = x[i0 + r];
+				length_type first = j > i ? 0 : r + 1;
+				for (length_type c = first; c < cells.getColumns(); c++)
+					sum -= a[r * cells.stride() + c] * x[j0 + c];
+				if (j == i) {
+					if (a[r * cells.stride() + r] == value_type(0)) throw ("Matrix with zero determinant!");
+					sum /= a[r * cells.stride() + r];
+				}
+				x[i0 + r] = sum;
+			}
+		}
+	}
+	return x;
+}
+
+TiledMatrix m::multiply (const TiledMatrix& t_left, const TiledMatrix& t_right, const std::string& t_path) {
+	if (t_left.getColumns() != t_right.getRows()) throw ("Matrices couldn't be multiplied!");
+	if (t_left.tileSize() != t_right.tileSize()) throw ("Tile sizes don't match!");
+	using length_type = TiledMatrix::length_type;
+	TiledMatrix res(createStore(t_path, t_left.getRows(), t_right.getColumns(), t_left.tileSize(), t_left.getBudget(),
+			{t_left.m_store.get(), t_right.m_store.get()}));
+	length_type rows = t_left.tileRows(), columns = t_right.tileColumns(), inner = t_left.tileColumns();
+
+	for (length_type i = 0; i < rows; i++)
+		for (length_type j = 0; j < columns; j++) {
+			std::optional<Matrix> sum;
+			for (length_type k = 0; k < inner; k++) {
+				// the next pair of tiles, in the order they are multiplied
+				length_type next_i = i, next_j = j, next_k = k + 1;
+				if (next_k == inner) { next_k = 0; next_j++; }
+				if (next_j == columns) { next_j = 0; next_i++; }
+				if (next_i < rows) {
+					t_left.prefetch(next_i, next_k);
+					t_right.prefetch(next_k, next_j);
+				}
+				const Matrix a = t_left.tile(i, k), b = t_right.tile(k, j);
+				if (!sum) sum.emplace(a.getRows(), b.getColumns(), tileResource());
+				detail::gemm(a.getRows(), b.getColumns(), a.getColumns(), value_type(1), a.data(), a.stride(),
+						b.data(), b.stride(), value_type(1), detail::writableView(*sum).data(), sum->stride());
+			}
+			res.setTile(i, j, *sum);
+		}
+	res.flush();
+	return res;
+}
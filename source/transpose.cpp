@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#define M_TRANSPOSE_SSE
+#endif
+#include "transpose.h"
+#include "thread_pool.h"
+
+using namespace m;
+
+namespace {
+	using value_type = Matrix::value_type;
+	using length_type = Matrix::length_type;
+	using task_list = std::vector<std::function<void ()>>;
+
+	constexpr length_type LEAF = 32;					// two 32x32 blocks of floats sit in L1 together
+	constexpr std::size_t TASK_CELLS = 1 << 16;		// cells moved by one piece of a parallel transpose
+
+	// writes the transpose of the 4x4 tile at t_a to t_b and that of the tile at t_b to t_a (t_a may be t_b)
+	inline void swapTile (value_type* t_a, value_type* t_b, std::size_t t_ld) {
+#ifdef M_TRANSPOSE_SSE
+		__m128 a0 = _mm_loadu_ps(t_a), a1 = _mm_loadu_ps(t_a + t_ld), a2 = _mm_loadu_ps(t_a + 2 * t_ld), a3 = _mm_loadu_ps(t_a + 3 * t_ld);
+		__m128 b0 = _mm_loadu_ps(t_b), b1 = _mm_loadu_ps(t_b + t_ld), b2 = _mm_loadu_ps(t_b + 2 * t_ld), b3 = _mm_loadu_ps(t_b + 3 * t_ld);
+		_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+		_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+		_mm_storeu_ps(t_b, a0); _mm_storeu_ps(t_b + t_ld, a1); _mm_storeu_ps(t_b + 2 * t_ld, a2); _mm_storeu_ps(t_b + 3 * t_ld, a3);
+		_mm_storeu_ps(t_a, b0); _mm_storeu_ps(t_a + t_ld, b1); _mm_storeu_ps(t_a + 2 * t_ld, b2); _mm_storeu_ps(t_a + 3 * t_ld, b3);
+#else
+		value_type a[16], b[16];
+		for (std::size_t i = 0; i < 4; i++)
+			for (std::size_t j = 0; j < 4; j++) {
+				a[j * 4 + i] = t_a[i * t_ld + j];
+				b[j * 4 + i] = t_b[i * t_ld + j];
+			}
+		for (std::size_t i = 0; i < 4; i++)
+			for (std::size_t j = 0; j < 4; j++) {
+				t_b[i * t_ld + j] = a[i * 4 + j];
+				t_a[i * t_ld + j] = b[i * 4 + j];
+			}
+#endif
+	}
+
+	// writes the transpose of the 4x4 tile at t_source to t_target
+	inline void copyTile (const value_type* t_source, std::size_t t_lds, value_type* t_target, std::size_t t_ldt) {
+#ifdef M_TRANSPOSE_SSE
+		__m128 r0 = _mm_loadu_ps(t_source), r1 = _mm_loadu_ps(t_source + t_lds);
+		__m128 r2 = _mm_loadu_ps(t_source + 2 * t_lds), r3 = _mm_loadu_ps(t_source + 3 * t_lds);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(t_target, r0); _mm_storeu_ps(t_target + t_ldt, r1);
+		_mm_storeu_ps(t_target + 2 * t_ldt, r2); _mm_storeu_ps(t_target + 3 * t_ldt, r3);
+#else
+		for (std::size_t i = 0; i < 4; i++)
+			for (std::size_t j = 0; j < 4; j++)
+				t_target[j * t_ldt + i] = t_source[i * t_lds + j];
+#endif
+	}
+
+	// splits a side at a multiple of 4, so the tiles of both halves stay whole
+	length_type half (length_type t_length) {
+		return t_length / 8 * 4;
+	}
+
+	void copyLeaf (const value_type* t_s, std::size_t t_lds, length_type t_rows, length_type t_columns, value_type* t_t, std::size_t t_ldt) {
+		length_type i = 0;
+		for (; i + 4 <= t_rows; i += 4) {
+			length_type j = 0;
+			for (; j + 4 <= t_columns; j += 4)
+				copyTile(t_s + i * t_lds + j, t_lds, t_t + j * t_ldt + i, t_ldt);
+			for (; j < t_columns; j++)
+				for (length_type r = i; r < i + 4; r++)
+					t_t[j * t_ldt + r] = t_s[r * t_lds + j];
+		}
+		for (; i < t_rows; i++)
+			for (length_type j = 0; j < t_columns; j++)
+				t_t[j * t_ldt + i] = t_s[i * t_lds + j];
+	}
+
+	// swaps the t_rows x t_columns block at t_a with the transpose of the t_columns x t_rows block at t_b
+	void swapLeaf (value_type* t_a, value_type* t_b, std::size_t t_ld, length_type t_rows, length_type t_columns) {
+		length_type i = 0;
+		for (; i + 4 <= t_rows; i += 4) {
+			length_type j = 0;
+			for (; j + 4 <= t_columns; j += 4)
+				swapTile(t_a + i * t_ld + j, t_b + j * t_ld + i, t_ld);
+			for (; j < t_columns; j++)
+				for (length_type r = i; r < i + 4; r++)
+					std::swap(t_a[r * t_ld + j], t_b[j * t_ld + r]);
+		}
+		for (; i < t_rows; i++)
+			for (length_type j = 0; j < t_columns; j++)
+				std::swap(t_a[i * t_ld + j], t_b[j * t_ld + i]);
+	}
+
+	void diagonalLeaf (value_type* t_a, std::size_t t_ld, length_type t_n) {
+		length_type whole = t_n / 4 * 4;
+		for (length_type i = 0; i < whole; i += 4)
+			for (length_type j = i; j < whole; j += 4)
+				swapTile(t_a + i * t_ld + j, t_a + j * t_ld + i, t_ld);
+		for (length_type i = 0; i < t_n; i++)
+			for (length_type j = std::max(i + 1, whole); j < t_n; j++)
+				std::swap(t_a[i * t_ld + j], t_a[j * t_ld + i]);
+	}
+
+	/* the recursions below halve the longer side until a block fits in LEAF x LEAF. With t_tasks given,
+	  they stop at blocks of TASK_CELLS instead and leave them in t_tasks to be run on any thread */
+
+	void copyRecursive (const value_type* t_s, std::size_t t_lds, length_type t_rows, length_type t_columns,
+			value_type* t_t, std::size_t t_ldt, task_list* t_tasks = nullptr) {
+		if (t_tasks && std::size_t(t_rows) * t_columns <= TASK_CELLS) {
+			t_tasks->push_back([=] () { copyRecursive(t_s, t_lds, t_rows, t_columns, t_t, t_ldt); });
+			return;
+		}
+		if (t_rows <= LEAF && t_columns <= LEAF) { copyLeaf(t_s, t_lds, t_rows, t_columns, t_t, t_ldt); return; }
+		if (t_rows >= t_columns) {
+			length_type h = half(t_rows);
+			copyRecursive(t_s, t_lds, h, t_columns, t_t, t_ldt, t_tasks);
+			copyRecursive(t_s + h * t_lds, t_lds, t_rows - h, t_columns, t_t + h, t_ldt, t_tasks);
+		}
+		else {
+			length_type h = half(t_columns);
+			copyRecursive(t_s, t_lds, t_rows, h, t_t, t_ldt, t_tasks);
+			copyRecursive(t_s + h, t_lds, t_rows, t_columns - h, t_t + h * t_ldt, t_ldt, t_tasks);
+		}
+	}
+
+	void swapRecursive (value_type* t_a, value_type* t_b, std::size_t t_ld, length_type t_rows, length_type t_columns,
+			task_list* t_tasks = nullptr) {
+		if (t_tasks && std::size_t(t_rows) * t_columns <= TASK_CELLS) {
+			t_tasks->push_back([=] () { swapRecursive(t_a, t_b, t_ld, t_rows, t_columns); });
+			return;
+		}
+		if (t_rows <= LEAF && t_columns <= LEAF) { swapLeaf(t_a, t_b, t_ld, t_rows, t_columns); return; }
+		if (t_rows >= t_columns) {
+			length_type h = half(t_rows);
+			swapRecursive(t_a, t_b, t_ld, h, t_columns, t_tasks);
+			swapRecursive(t_a + h * t_ld, t_b + h, t_ld, t_rows - h, t_columns, t_tasks);
+		}
+		else {
+			length_type h = half(t_columns);
+			swapRecursive(t_a, t_b, t_ld, t_rows, h, t_tasks);
+			swapRecursive(t_a + h, t_b + h * t_ld, t_ld, t_rows, t_columns - h, t_tasks);
+		}
+	}
+
+	// [A11 A12; A21 A22]: A11 and A22 are transposed in place, A12 swapped with the transpose of A21
+	void diagonalRecursive (value_type* t_a, std::size_t t_ld, length_type t_n, task_list* t_tasks = nullptr) {
+		if (t_tasks && std::size_t(t_n) * t_n <= TASK_CELLS) {
+			t_tasks->push_back([=] () { diagonalRecursive(t_a, t_ld, t_n); });
+			return;
+		}
+		if (t_n <= LEAF) { diagonalLeaf(t_a, t_ld, t_n); return; }
+		length_type h = half(t_n);
+		diagonalRecursive(t_a, t_ld, h, t_tasks);
+		diagonalRecursive(t_a + h * t_ld + h, t_ld, t_n - h, t_tasks);
+		swapRecursive(t_a + h, t_a + h * t_ld, t_ld, h, t_n - h, t_tasks);
+	}
+
+	void run (const task_list& t_tasks) {
+		detail::ThreadPool& pool = detail::ThreadPool::instance();
+		if (pool.size() <= 1 || t_tasks.size() < 2) {
+			for (const std::function<void ()>& task : t_tasks) task();
+			return;
+		}
+		pool.parallelFor(0, t_tasks.size(), 1, [&t_tasks] (std::size_t t_first, std::size_t t_last) {
+			for (std::size_t k = t_first; k < t_last; k++) t_tasks[k]();
+		});
+	}
+
+	bool parallel (std::size_t t_cells) {
+		return t_cells >= detail::parallel_cells && detail::ThreadPool::instance().size() > 1;
+	}
+
+	// t_a * t_b % t_modulus without overflowing
+	std::size_t multiplyModulo (std::size_t t_a, std::size_t t_b, std::size_t t_modulus) {
+		if (t_b == 0 || t_a <= SIZE_MAX / t_b) return t_a * t_b % t_modulus;
+		std::size_t res = 0;
+		for (t_a %= t_modulus; t_b; t_b >>= 1) {
+			if (t_b & 1) res = (res + t_a) % t_modulus;
+			t_a = (t_a * 2) % t_modulus;
+		}
+		return res;
+	}
+}
+
+void detail::transposeCopy (const value_type* t_source, std::size_t t_lds, length_type t_rows, length_type t_columns,
+		value_type* t_target, std::size_t t_ldt) {
+	if (!parallel(std::size_t(t_rows) * t_columns)) { copyRecursive(t_source, t_lds, t_rows, t_columns, t_target, t_ldt); return; }
+	task_list tasks;
+	copyRecursive(t_source, t_lds, t_rows, t_columns, t_target, t_ldt, &tasks);
+	run(tasks);
+}
+
+void detail::transposeSquare (value_type* t_data, std::size_t t_ld, length_type t_n) {
+	if (!parallel(std::size_t(t_n) * t_n)) { diagonalRecursive(t_data, t_ld, t_n); return; }
+	task_list tasks;
+	diagonalRecursive(t_data, t_ld, t_n, &tasks);
+	run(tasks);
+}
+
+void detail::transposePacked (value_type* t_data, length_type t_rows, length_type t_columns) {
+	// cell k = i * columns + j goes to j * rows + i = k * rows mod (cells - 1); the first and last cells stay
+	std::size_t cells = std::size_t(t_rows) * t_columns;
+	if (t_rows == 1 || t_columns == 1) return;
+	std::size_t modulus = cells - 1;
+	std::vector<bool> moved(cells, false);
+	for (std::size_t start = 1; start < modulus; start++) {
+		if (moved[start]) continue;
+		value_type carried = t_data[start];
+		std::size_t k = start;
+		do {
+			k = multiplyModulo(k, t_rows, modulus);
+			std::swap(carried, t_data[k]);
+			moved[k] = true;
+		} while (k != start);
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef MATRIX_TRANSPOSE_CRYPT_10_10
+#define MATRIX_TRANSPOSE_CRYPT_10_10
+
+#include <cstddef>
+#include "matrix.h"
+
+namespace m {
+	namespace detail {
+
+		/* transposes in memory. Blocks are halved along their longer side until they fit in L1, whatever
+		  its size (cache-oblivious), and leaves are moved in 4x4 tiles transposed in SIMD registers.
+		  Large jobs are cut into independent pieces run across the thread pool. */
+
+		// writes the transpose of the t_rows x t_columns cells at t_source (rows t_lds apart) to t_target (rows t_ldt apart)
+		void transposeCopy (const Matrix::value_type* t_source, std::size_t t_lds, Matrix::length_type t_rows,
+				Matrix::length_type t_columns, Matrix::value_type* t_target, std::size_t t_ldt);
+
+		// transposes the t_n x t_n cells at t_data (rows t_ld apart) in place
+		void transposeSquare (Matrix::value_type* t_data, std::size_t t_ld, Matrix::length_type t_n);
+
+		/* transposes the t_rows x t_columns cells stored row after row without padding at t_data in place,
+		  following the cycles of the permutation; the only extra memory is one bit per cell */
+		void transposePacked (Matrix::value_type* t_data, Matrix::length_type t_rows, Matrix::length_type t_columns);
+	}
+}
+
+#endif
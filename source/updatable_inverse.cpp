@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "updatable_inverse.h"
+#include "lu.h"
+#include "thread_pool.h"
+
+using namespace m;
+
+namespace {
+	using value_type = UpdatableInverse::value_type;
+	using length_type = UpdatableInverse::length_type;
+
+	constexpr std::size_t PARALLEL_CELLS = 1 << 15;		// smaller updates stay on the calling thread
+	constexpr std::size_t CHECK_EVERY = 4;				// changes between two drift measurements
+
+	// calls t_body(first, last) over [0, t_count) split across the pool when t_work cells are touched
+	template <class Body>
+	void split (std::size_t t_count, std::size_t t_work, Body&& t_body) {
+		detail::ThreadPool& pool = detail::ThreadPool::instance();
+		if (pool.size() <= 1 || t_work < PARALLEL_CELLS || t_count < 2) { t_body(std::size_t(0), t_count); return; }
+		std::size_t grain = std::max<std::size_t>(1, t_count / (std::size_t(pool.size()) * 4));
+		pool.parallelFor(0, t_count, grain, t_body);
+	}
+
+	value_type dot (const value_type* t_a, const value_type* t_b, length_type t_length) {
+		value_type res = value_type(0);
+		for (length_type k = 0; k < t_length; k++)
+			res += t_a[k] * t_b[k];
+		return res;
+	}
+}
+
+UpdatableInverse::UpdatableInverse (const Matrix& t_matrix, value_type t_drift_threshold)
+		: m_matrix(t_matrix), m_inverse(), m_threshold(t_drift_threshold) {
+	if (t_matrix.getRows() != t_matrix.getColumns()) throw ("Matrix has no inverse!");
+	m_matrix.removeSeperators();
+	refactor();
+	if (m_singular) throw ("Matrix with zero determinant!");
+}
+
+UpdatableInverse::length_type UpdatableInverse::size () const {
+	return m_matrix.getRows();
+}
+
+const Matrix& UpdatableInverse::matrix () const {
+	return m_matrix;
+}
+
+const Matrix& UpdatableInverse::inverse () const {
+	if (m_singular) throw ("Matrix with zero determinant!");
+	return m_inverse;
+}
+
+UpdatableInverse::value_type UpdatableInverse::determinant () const {
+	return m_determinant;
+}
+
+bool UpdatableInverse::isSingular () const {
+	return m_singular;
+}
+
+void UpdatableInverse::update (const std::vector<value_type>& t_u, const std::vector<value_type>& t_v) {
+	length_type n = size();
+	if (t_u.size() != n || t_v.size() != n) throw ("Size of update vectors doesn't match!");
+	std::vector<value_type> w = m_rightProduct(t_u), z = m_leftProduct(t_v);
+	value_type vw = dot(t_v.data(), w.data(), n);
+	value_type* a = detail::writableView(m_matrix).data();
+	std::size_t lda = m_matrix.stride();
+	split(n, std::size_t(n) * n, [&] (std::size_t t_first, std::size_t t_last) {
+		for (std::size_t i = t_first; i < t_last; i++) {
+			if (t_u[i] == value_type(0)) continue;
+			value_type* row = a + i * lda;
+			for (length_type j = 0; j < n; j++)
+				row[j] += t_u[i] * t_v[j];
+		}
+	});
+	m_apply(w, z, vw);
+}
+
+void UpdatableInverse::setCell (length_type t_row, length_type t_column, value_type t_value) {
+	length_type n = size();
+	if (t_row >= n || t_column >= n) throw ("Indices are out of bound!");
+	value_type delta = t_value - m_matrix.getCell(t_row, t_column);
+	if (delta == value_type(0)) return;
+	// u = delta * e_row, v = e_column: A^-1 * u is a column of the inverse, v^T * A^-1 a row of it
+	std::vector<value_type> w = m_inverseColumn(t_row);
+	for (value_type& cell : w) cell *= delta;
+	const value_type* inverse_row = static_cast<const Matrix&>(m_inverse).data() + std::size_t(t_column) * m_inverse.stride();
+	std::vector<value_type> z(inverse_row, inverse_row + n);
+	m_matrix.setCell(t_row, t_column, t_value);
+	m_apply(w, z, w[t_column]);
+}
+
+void UpdatableInverse::addToRow (length_type t_row, const std::vector<value_type>& t_delta) {
+	length_type n = size();
+	if (t_row >= n) throw ("Row is out of bound!");
+	if (t_delta.size() != n) throw ("Size of update vectors doesn't match!");
+	// u = e_row, v = t_delta
+	std::vector<value_type> w = m_inverseColumn(t_row), z = m_leftProduct(t_delta);
+	value_type* row = detail::writableView(m_matrix).data() + std::size_t(t_row) * m_matrix.stride();
+	for (length_type j = 0; j < n; j++)
+		row[j] += t_delta[j];
+	m_apply(w, z, z[t_row]);
+}
+
+void UpdatableInverse::addToColumn (length_type t_column, const std::vector<value_type>& t_delta) {
+	length_type n = size();
+	if (t_column >= n) throw ("Column is out of bound!");
+	if (t_delta.size() != n) throw ("Size of update vectors doesn't match!");
+	// u = t_delta, v = e_column
+	std::vector<value_type> w = m_rightProduct(t_delta);
+	const value_type* inverse_row = static_cast<const Matrix&>(m_inverse).data() + std::size_t(t_column) * m_inverse.stride();
+	std::vector<value_type> z(inverse_row, inverse_row + n);
+	value_type* a = detail::writableView(m_matrix).data();
+	std::size_t lda = m_matrix.stride();
+	for (length_type i = 0; i < n; i++)
+		a[i * lda + t_column] += t_delta[i];
+	m_apply(w, z, w[t_column]);
+}
+
+void UpdatableInverse::addRowMultiple (length_type t_source, length_type t_target, value_type t_multiple) {
+	length_type n = size();
+	if (t_source >= n || t_target >= n) throw ("Rows must be contained in the main matrix!");
+	if (t_multiple == value_type(0)) return;
+	value_type* a = detail::writableView(m_matrix).data();
+	std::size_t lda = m_matrix.stride();
+	if (t_source == t_target) {		// scales the row, a rank-1 change like any other
+		std::vector<value_type> delta(a + t_source * lda, a + t_source * lda + n);
+		for (value_type& cell : delta) cell *= t_multiple;
+		addToRow(t_target, delta);
+		return;
+	}
+	const value_type* source = a + t_source * lda;
+	value_type* target = a + t_target * lda;
+	for (length_type j = 0; j < n; j++)
+		target[j] += source[j] * t_multiple;
+	if (m_singular) { refactor(); return; }
+	// (E * A)^-1 = A^-1 * E^-1 with E^-1 = I - t_multiple * e_target * e_source^T
+	value_type* inverse = detail::writableView(m_inverse).data();
+	std::size_t ldi = m_inverse.stride();
+	for (length_type i = 0; i < n; i++)
+		inverse[i * ldi + t_source] -= t_multiple * inverse[i * ldi + t_target];
+	m_changed();
+}
+
+std::vector<UpdatableInverse::value_type> UpdatableInverse::solve (const std::vector<value_type>& t_b) const {
+	if (t_b.size() != size()) throw ("Size of right-hand side doesn't match!");
+	if (m_singular) throw ("Matrix with zero determinant!");
+	return m_rightProduct(t_b);
+}
+
+void UpdatableInverse::refactor () {
+	LU factorization(m_matrix);
+	m_singular = factorization.isSingular();
+	m_determinant = m_singular ? value_type(0) : factorization.determinant();
+	if (!m_singular) m_inverse = factorization.inverse();
+	m_updates = 0;
+	m_refactors++;
+	m_baseline = m_drift = m_singular ? value_type(0) : m_residual(0);
+	m_checked = size() > 1 ? 1 : 0;
+}
+
+UpdatableInverse::value_type UpdatableInverse::getDriftThreshold () const {
+	return m_threshold;
+}
+
+void UpdatableInverse::setDriftThreshold (value_type t_drift_threshold) {
+	m_threshold = t_drift_threshold;
+}
+
+UpdatableInverse::value_type UpdatableInverse::drift () const {
+	return m_drift;
+}
+
+std::size_t UpdatableInverse::updates () const {
+	return m_updates;
+}
+
+std::size_t UpdatableInverse::refactors () const {
+	return m_refactors;
+}
+
+std::vector<UpdatableInverse::value_type> UpdatableInverse::m_leftProduct (const std::vector<value_type>& t_vector) const {
+	length_type n = size();
+	const value_type* inverse = m_inverse.data();
+	std::size_t ldi = m_inverse.stride();
+	std::vector<value_type> res(n, value_type(0));
+	// rows of the inverse are added up, blocks of columns going to different threads
+	split(n, std::size_t(n) * n, [&] (std::size_t t_first, std::size_t t_last) {
+		for (length_type k = 0; k < n; k++) {
+			value_type multiple = t_vector[k];
+			if (multiple == value_type(0)) continue;
+			const value_type* row = inverse + k * ldi;
+			for (std::size_t j = t_first; j < t_last; j++)
+				res[j] += multiple * row[j];
+		}
+	});
+	return res;
+}
+
+std::vector<UpdatableInverse::value_type> UpdatableInverse::m_rightProduct (const std::vector<value_type>& t_vector) const {
+	length_type n = size();
+	const value_type* inverse = m_inverse.data();
+	std::size_t ldi = m_inverse.stride();
+	std::vector<value_type> res(n);
+	split(n, std::size_t(n) * n, [&] (std::size_t t_first, std::size_t t_last) {
+		for (std::size_t i = t_first; i < t_last; i++)
+			res[i] = dot(inverse + i * ldi, t_vector.data(), n);
+	});
+	return res;
+}
+
+std::vector<UpdatableInverse::value_type> UpdatableInverse::m_inverseColumn (length_type t_column) const {
+	length_type n = size();
+	const value_type* inverse = m_inverse.data();
+	std::size_t ldi = m_inverse.stride();
+	std::vector<value_type> res(n);
+	for (length_type i = 0; i < n; i++)
+		res[i] = inverse[i * ldi + t_column];
+	return res;
+}
+
+void UpdatableInverse::m_apply (const std::vector<value_type>& t_w, const std::vector<value_type>& t_z, value_type t_vw) {
+	value_type denominator = value_type(1) + t_vw;
+	// a denominator lost in the rounding of 1 + v^T * A^-1 * u means the matrix (nearly) became singular
+	value_type tiny = 16 * std::numeric_limits<value_type>::epsilon() * std::max(value_type(1), std::fabs(t_vw));
+	if (m_singular || std::fabs(denominator) <= tiny) { refactor(); return; }
+	length_type n = size();
+	value_type* inverse = detail::writableView(m_inverse).data();
+	std::size_t ldi = m_inverse.stride();
+	split(n, std::size_t(n) * n, [&] (std::size_t t_first, std::size_t t_last) {
+		for (std::size_t i = t_first; i < t_last; i++) {
+			value_type multiple = t_w[i] / denominator;
+			if (multiple == value_type(0)) continue;
+			value_type* row = inverse + i * ldi;
+			for (length_type j = 0; j < n; j++)
+				row[j] -= multiple * t_z[j];
+		}
+	});
+	m_determinant *= denominator;
+	m_changed();
+}
+
+void UpdatableInverse::m_changed () {
+	m_updates++;
+	if (m_updates % CHECK_EVERY) return;
+	m_drift = m_residual(m_checked);
+	m_checked = m_checked + 1 < size() ? m_checked + 1 : 0;
+	if (m_drift > m_threshold + m_baseline) refactor();
+}
+
+UpdatableInverse::value_type UpdatableInverse::m_residual (length_type t_column) const {
+	length_type n = size();
+	std::vector<value_type> column = m_inverseColumn(t_column), residual(n);
+	const value_type* a = m_matrix.data();
+	std::size_t lda = m_matrix.stride();
+	split(n, std::size_t(n) * n, [&] (std::size_t t_first, std::size_t t_last) {
+		for (std::size_t i = t_first; i < t_last; i++)
+			residual[i] = std::fabs(dot(a + i * lda, column.data(), n) - (i == t_column ? value_type(1) : value_type(0)));
+	});
+	return *std::max_element(residual.begin(), residual.end());
+}